@@ -5,6 +5,7 @@
 #ifndef STANDARDESE_COMMENT_HPP_INCLUDED
 #define STANDARDESE_COMMENT_HPP_INCLUDED
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
@@ -71,16 +72,49 @@ private:
     std::unordered_map<std::string, comment::doc_comment> modules_;
 };
 
+/// Caches the unique names of parent entities.
+///
+/// The unique name of an entity is built from the unique names of all its parents,
+/// so every entity would otherwise recompute the names of all its ancestors.
+/// \notes The cache must not be used anymore once the comments of a parent change.
+class unique_name_cache
+{
+public:
+    /// \returns The cached unique name of the parent, if there is any.
+    type_safe::optional_ref<const std::string> lookup(const cppast::cpp_entity& parent) const
+    {
+        auto iter = names_.find(&parent);
+        if (iter == names_.end())
+            return nullptr;
+        return type_safe::ref(iter->second);
+    }
+
+    /// \effects Caches the unique name of the parent.
+    /// \returns A reference to the cached name.
+    const std::string& insert(const cppast::cpp_entity& parent, std::string name)
+    {
+        return names_.emplace(&parent, std::move(name)).first->second;
+    }
+
+private:
+    std::unordered_map<const cppast::cpp_entity*, std::string> names_;
+};
+
 /// \returns The unique name of the given entity.
 std::string lookup_unique_name(const comment_registry& registry, const cppast::cpp_entity& e);
 
+/// \returns The unique name of the given entity.
+/// \effects Uses and fills the cache for the unique names of the parents.
+std::string lookup_unique_name(const comment_registry& registry, const cppast::cpp_entity& e,
+                               unique_name_cache& cache);
+
 /// Parses the comments in several files and connects them in a shared registry.
 class file_comment_parser
 {
 public:
     explicit file_comment_parser(type_safe::object_ref<const cppast::diagnostic_logger> logger,
                                  comment::config config = comment::config())
-    : config_(std::move(config)), logger_(logger)
+    : config_(std::make_shared<const comment::config>(std::move(config))), logger_(logger)
     {}
 
     /// Parse all comments in `file`.
@@ -103,9 +137,11 @@ private:
     void group_uncommented();
 
     bool register_commented(type_safe::object_ref<const cppast::cpp_entity> entity,
-                            comment::doc_comment comment, bool allow_cmd = true) const;
+                            comment::doc_comment comment, bool allow_cmd = true,
+                            type_safe::optional_ref<unique_name_cache> names = nullptr) const;
 
-    void register_uncommented(type_safe::object_ref<const cppast::cpp_entity> entity) const;
+    void register_uncommented(type_safe::object_ref<const cppast::cpp_entity> entity,
+                              unique_name_cache&                              names) const;
 
     type_safe::optional_ref<const comment::doc_comment> get_comment(
         const cppast::cpp_entity& e) const
@@ -114,14 +150,15 @@ private:
         return registry_.get_comment(e);
     }
 
-    std::string get_parent_unique_name(const cppast::cpp_entity& e) const;
+    std::string get_parent_unique_name(const cppast::cpp_entity& e,
+                                       unique_name_cache&        names) const;
 
     mutable std::mutex                                                      mutex_;
     mutable std::unordered_multimap<std::string, const cppast::cpp_entity*> uncommented_;
     mutable comment_registry                                                registry_;
     mutable std::vector<comment::parse_result>                              free_comments_;
 
-    comment::config                                        config_;
+    std::shared_ptr<const comment::config>                 config_;
     type_safe::object_ref<const cppast::diagnostic_logger> logger_;
 };
 } // namespace standardese
@@ -5,15 +5,113 @@
 #ifndef STANDARDESE_COMMENT_DOC_COMMENT_HPP_INCLUDED
 #define STANDARDESE_COMMENT_DOC_COMMENT_HPP_INCLUDED
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <standardese/comment/metadata.hpp>
 #include <standardese/markup/doc_section.hpp>
 #include <standardese/markup/documentation.hpp>
 #include <standardese/markup/index.hpp>
 
+extern "C"
+{
+    typedef struct cmark_node   cmark_node;
+    typedef struct cmark_parser cmark_parser;
+}
+
 namespace standardese
 {
 namespace comment
 {
+    class config;
+
+    namespace detail
+    {
+        // the sections of a comment, owned by the caller
+        struct owned_sections
+        {
+            std::unique_ptr<markup::brief_section>            brief;
+            std::vector<std::unique_ptr<markup::doc_section>> sections;
+        };
+
+        // the sections of a comment
+        //
+        // They are either built directly or built from the AST of the comment on first access.
+        // Parsed sections can be handed over, the text is kept to parse them again if needed.
+        class comment_sections
+        {
+        public:
+            comment_sections(std::unique_ptr<markup::brief_section>            brief,
+                             std::vector<std::unique_ptr<markup::doc_section>> sections)
+            : sections_(std::move(sections)), brief_(std::move(brief)), root_(nullptr),
+              parsed_(true), has_matching_entity_(false)
+            {}
+
+            // takes ownership of the root, the parser keeps the syntax extensions of its nodes
+            comment_sections(std::shared_ptr<const comment::config> config, std::string text,
+                             std::shared_ptr<cmark_parser> parser, cmark_node* root,
+                             bool has_matching_entity)
+            : config_(std::move(config)), text_(std::move(text)), parser_(std::move(parser)),
+              root_(root), parsed_(false), has_matching_entity_(has_matching_entity)
+            {}
+
+            // defined in parser.cpp
+            ~comment_sections() noexcept;
+
+            comment_sections(const comment_sections&) = delete;
+            comment_sections& operator=(const comment_sections&) = delete;
+
+            // thread-safe, but the reference is invalidated by take()
+            const std::vector<std::unique_ptr<markup::doc_section>>& sections() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!parsed_)
+                    parse();
+                return sections_;
+            }
+
+            // thread-safe, but the reference is invalidated by take()
+            const std::unique_ptr<markup::brief_section>& brief() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!parsed_)
+                    parse();
+                return brief_;
+            }
+
+            // thread-safe
+            // hands over the parsed sections and goes back to the unparsed state,
+            // sections that were built directly are copied
+            owned_sections take() const;
+
+            // thread-safe
+            // copies the sections, they are kept
+            owned_sections copy() const;
+
+        private:
+            // defined in parser.cpp
+            void parse() const;
+
+            // requires the lock
+            owned_sections clone() const;
+
+            mutable std::mutex                                        mutex_;
+            mutable std::vector<std::unique_ptr<markup::doc_section>> sections_;
+            mutable std::unique_ptr<markup::brief_section>            brief_;
+
+            // only set if the sections are parsed from the text
+            std::shared_ptr<const comment::config> config_;
+            std::string                            text_;
+            // only set until the sections are built for the first time
+            mutable std::shared_ptr<cmark_parser> parser_;
+            mutable cmark_node*                   root_;
+            mutable bool                          parsed_;
+            bool                                  has_matching_entity_;
+        };
+    } // namespace detail
+
     /// The comment associated with an entity.
     class doc_comment
     {
@@ -22,6 +120,8 @@ namespace comment
         class section_range
         {
         public:
+            section_range() noexcept : begin_(), end_() {}
+
             section_range(const std::vector<std::unique_ptr<markup::doc_section>>& sections)
             : begin_(sections.begin()), end_(sections.end())
             {}
@@ -55,7 +155,24 @@ namespace comment
         /// \requires Sections must not contain the brief section.
         doc_comment(comment::metadata metadata, std::unique_ptr<markup::brief_section> brief,
                     std::vector<std::unique_ptr<markup::doc_section>> sections)
-        : metadata_(std::move(metadata)), sections_(std::move(sections)), brief_(std::move(brief))
+        : metadata_(std::move(metadata))
+        {
+            if (brief || !sections.empty())
+                sections_.reset(
+                    new detail::comment_sections(std::move(brief), std::move(sections)));
+        }
+
+        /// \effects Creates it giving the metadata, the text of the comment and its AST.
+        /// The sections will be built from the AST on first access,
+        /// it takes ownership of `root`.
+        /// \requires The text must contain at least one section and must have been parsed by
+        /// `parser` into `root` before, so it is known to be valid.
+        doc_comment(comment::metadata metadata, std::shared_ptr<const comment::config> config,
+                    std::string text, std::shared_ptr<cmark_parser> parser, cmark_node* root,
+                    bool has_matching_entity)
+        : metadata_(std::move(metadata)),
+          sections_(new detail::comment_sections(std::move(config), std::move(text),
+                                                 std::move(parser), root, has_matching_entity))
         {}
 
         /// \returns The metadata of the comment.
@@ -71,22 +188,61 @@ namespace comment
             return metadata_;
         }
 
+        /// \returns Whether or not the comment has a brief section or any other sections.
+        /// \notes Unlike the other functions, this does not need to parse the sections.
+        bool has_sections() const noexcept
+        {
+            return sections_ != nullptr;
+        }
+
         /// \returns The non-brief documentation sections.
-        section_range sections() const noexcept
+        /// \notes This function is thread-safe.
+        section_range sections() const
         {
-            return section_range(sections_);
+            if (!sections_)
+                return section_range();
+            return section_range(sections_->sections());
         }
 
         /// \returns A reference to the brief section, if there is one.
-        type_safe::optional_ref<const markup::brief_section> brief_section() const noexcept
+        /// \notes This function is thread-safe.
+        type_safe::optional_ref<const markup::brief_section> brief_section() const
+        {
+            if (!sections_)
+                return nullptr;
+            return type_safe::opt_ref(sections_->brief().get());
+        }
+
+        /// \returns The brief section and the non-brief sections, owned by the caller.
+        /// \effects If the sections were parsed from the comment text,
+        /// they are moved out and only parsed again on the next access.
+        /// Otherwise they are copied.
+        /// \notes This function is thread-safe,
+        /// but it invalidates references obtained from the other functions.
+        detail::owned_sections take_sections() const
         {
-            return type_safe::opt_ref(brief_.get());
+            if (!sections_)
+                return {};
+            return sections_->take();
+        }
+
+        /// \returns Copies of the brief section and the non-brief sections.
+        /// \notes This function is thread-safe,
+        /// the sections are copied while no other thread can take them.
+        detail::owned_sections copy_sections() const
+        {
+            if (!sections_)
+                return {};
+            return sections_->copy();
         }
 
     private:
-        comment::metadata                                 metadata_;
-        std::vector<std::unique_ptr<markup::doc_section>> sections_;
-        std::unique_ptr<markup::brief_section>            brief_;
+        doc_comment(comment::metadata metadata, std::unique_ptr<detail::comment_sections> sections)
+        : metadata_(std::move(metadata)), sections_(std::move(sections))
+        {}
+
+        comment::metadata                         metadata_;
+        std::unique_ptr<detail::comment_sections> sections_;
 
         friend doc_comment merge(comment::metadata data, doc_comment&& other);
     };
@@ -97,7 +253,8 @@ namespace comment
     /// `other.metadata()`, which aren't set in `data`.
     doc_comment merge(metadata data, doc_comment&& other);
 
-    /// \effects Adds a copy of the sections to the documentation builder.
+    /// \effects Adds the sections to the documentation builder,
+    /// they are taken from the comment as in [standardese::comment::doc_comment::take_sections]().
     /// \group set_sections
     void set_sections(markup::entity_documentation::builder& builder, const doc_comment& comment);
 
@@ -110,6 +267,12 @@ namespace comment
 
     /// \group set_sections
     void set_sections(markup::module_documentation::builder& builder, const doc_comment& comment);
+
+    /// \effects Adds copies of the sections to the documentation builder,
+    /// the comment keeps them,
+    /// so they can still be taken by [standardese::comment::set_sections]().
+    void copy_sections(markup::namespace_documentation::builder& builder,
+                       const doc_comment&                        comment);
 } // namespace comment
 } // namespace standardese
 
@@ -5,6 +5,7 @@
 #ifndef STANDARDESE_COMMENT_PARSER_HPP_INCLUDED
 #define STANDARDESE_COMMENT_PARSER_HPP_INCLUDED
 
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -38,6 +39,9 @@ namespace comment
         /// \effects Creates a new parser using the given configuration.
         parser(comment::config c = comment::config());
 
+        /// \effects Creates a new parser sharing the given configuration.
+        explicit parser(std::shared_ptr<const comment::config> c);
+
         ~parser() noexcept;
 
         parser(const parser&) = delete;
@@ -45,19 +49,33 @@ namespace comment
 
         /// \returns The parser.
         cmark_parser* get() const noexcept
+        {
+            return parser_.get();
+        }
+
+        /// \returns The parser, shared with the comments that are parsed lazily.
+        /// \notes The nodes it creates refer to its syntax extensions,
+        /// so it must live as long as they do.
+        const std::shared_ptr<cmark_parser>& shared_parser() const noexcept
         {
             return parser_;
         }
 
         /// \returns The config.
         const comment::config& config() const noexcept
+        {
+            return *config_;
+        }
+
+        /// \returns The config, shared with the comments that are parsed lazily.
+        const std::shared_ptr<const comment::config>& shared_config() const noexcept
         {
             return config_;
         }
 
     private:
-        comment::config config_;
-        cmark_parser*   parser_;
+        std::shared_ptr<const comment::config> config_;
+        std::shared_ptr<cmark_parser>          parser_;
     };
 
     /// An unmatched documentation comment.
@@ -111,6 +129,8 @@ namespace comment
 
     /// Parses the comment.
     /// \returns The parsed comment.
+    /// Only its metadata and inline comments are built,
+    /// the documentation sections are built on first access.
     /// \throws [standardese::comment::parse_error]() if an error occurred.
     parse_result parse(const parser& p, const std::string& comment, bool has_matching_entity);
 } // namespace comment
@@ -6,10 +6,15 @@
 #define STANDARDESE_DOC_ENTITY_HPP_INCLUDED
 
 #include <cassert>
-#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <cppast/code_generator.hpp>
 #include <cppast/cpp_entity.hpp>
+#include <cppast/cpp_entity_index.hpp>
 #include <cppast/cpp_namespace.hpp>
 
 #include "index.hpp"
@@ -144,9 +149,56 @@ public:
         order_ = order;
     }
 
+    /// A function that runs the given task asynchronously, e.g. on a thread pool.
+    using executor = std::function<void(std::function<void()>)>;
+
+    /// \returns The minimal number of children a file or namespace must have,
+    /// so that the documentation of the children is generated in parallel.
+    /// If it is `0`, it is always generated on the calling thread.
+    std::size_t parallel_threshold() const noexcept
+    {
+        return parallel_threshold_;
+    }
+
+    /// \effects Sets the parallel threshold.
+    /// \notes It has no effect unless an executor is set as well.
+    void set_parallel_threshold(std::size_t threshold) noexcept
+    {
+        parallel_threshold_ = threshold;
+    }
+
+    /// \returns The executor that is used to generate the documentation of children in parallel.
+    const executor& get_executor() const noexcept
+    {
+        return executor_;
+    }
+
+    /// \effects Sets the executor that is used to generate the documentation of children
+    /// in parallel.
+    /// \notes The calling thread participates in the generation as well and only waits for tasks
+    /// that have already been started,
+    /// so the executor may be a thread pool that is also running the calling thread.
+    /// The documentation is always returned in the same order.
+    /// At most `no_threads` tasks are started for the children of one file or namespace,
+    /// it should be the number of threads the executor runs the tasks on.
+    void set_executor(executor e, std::size_t no_threads)
+    {
+        executor_   = std::move(e);
+        no_threads_ = no_threads;
+    }
+
+    /// \returns The number of threads the executor runs the tasks on.
+    std::size_t executor_threads() const noexcept
+    {
+        return no_threads_;
+    }
+
 private:
     flags               flags_;
     entity_index::order order_;
+    executor            executor_;
+    std::size_t         no_threads_         = 0u;
+    std::size_t         parallel_threshold_ = 0u;
 };
 
 namespace detail
@@ -302,11 +354,12 @@ private:
     virtual markup::block_id do_get_id() const = 0;
 
     /// \exclude
+    /// The synopsis of `synopsis_entity` is only generated if the documentation shows it.
     virtual std::unique_ptr<markup::documentation_entity> do_generate_documentation(
         const generation_config& gen_config, const synopsis_config& syn_config,
         const cppast::cpp_entity_index&                     index,
         type_safe::optional_ref<detail::inline_entity_list> inlines,
-        std::unique_ptr<markup::code_block>                 synopsis) const = 0;
+        const doc_entity&                                   synopsis_entity) const = 0;
 
     /// \exclude
     virtual cppast::code_generator::generation_options do_get_generation_options(
@@ -349,6 +402,8 @@ private:
 
 /// Generates synopsis for that entity.
 /// \returns The synopsis of that entity.
+/// \notes The resolved references of the synopsis are cached in the file of the entity.
+/// This function is thread safe.
 std::unique_ptr<markup::code_block> generate_synopsis(const synopsis_config&          config,
                                                       const cppast::cpp_entity_index& index,
                                                       const doc_entity&               entity);
@@ -380,8 +435,7 @@ private:
 
     std::unique_ptr<markup::documentation_entity> do_generate_documentation(
         const generation_config&, const synopsis_config&, const cppast::cpp_entity_index&,
-        type_safe::optional_ref<detail::inline_entity_list>,
-        std::unique_ptr<markup::code_block>) const override
+        type_safe::optional_ref<detail::inline_entity_list>, const doc_entity&) const override
     {
         return nullptr;
     }
@@ -452,7 +506,7 @@ private:
         const generation_config& gen_config, const synopsis_config& syn_config,
         const cppast::cpp_entity_index&                     index,
         type_safe::optional_ref<detail::inline_entity_list> inlines,
-        std::unique_ptr<markup::code_block>                 synopsis) const override;
+        const doc_entity&                                   synopsis_entity) const override;
 
     cppast::code_generator::generation_options do_get_generation_options(
         const synopsis_config& config, bool is_main) const override;
@@ -509,7 +563,7 @@ private:
         const generation_config& gen_config, const synopsis_config& syn_config,
         const cppast::cpp_entity_index&                     index,
         type_safe::optional_ref<detail::inline_entity_list> inlines,
-        std::unique_ptr<markup::code_block>                 synopsis) const override;
+        const doc_entity&                                   synopsis_entity) const override;
 
     cppast::code_generator::generation_options do_get_generation_options(
         const synopsis_config& config, bool is_main) const override;
@@ -570,7 +624,7 @@ private:
         const generation_config& gen_config, const synopsis_config& syn_config,
         const cppast::cpp_entity_index&                     index,
         type_safe::optional_ref<detail::inline_entity_list> inlines,
-        std::unique_ptr<markup::code_block>                 synopsis) const override;
+        const doc_entity&                                   synopsis_entity) const override;
 
     cppast::code_generator::generation_options do_get_generation_options(
         const synopsis_config& config, bool is_main) const override;
@@ -601,7 +655,7 @@ public:
     }
 
     /// \returns The incomplete namespace documentation.
-    /// It is used for the [standardese::entity_index]().
+    /// It is used for the [standardese::entity_index](), the sections of the comment are copied.
     markup::namespace_documentation::builder get_builder() const;
 
 private:
@@ -625,7 +679,7 @@ private:
         const generation_config& gen_config, const synopsis_config& syn_config,
         const cppast::cpp_entity_index&                     index,
         type_safe::optional_ref<detail::inline_entity_list> inlines,
-        std::unique_ptr<markup::code_block>                 synopsis) const override;
+        const doc_entity&                                   synopsis_entity) const override;
 
     cppast::code_generator::generation_options do_get_generation_options(
         const synopsis_config& config, bool is_main) const override;
@@ -666,6 +720,12 @@ public:
         return output_name_;
     }
 
+    /// \effects Gives up the ownership of the file and resets the user data of its entities,
+    /// so that the documentation entities can be built for it again.
+    /// \returns The file.
+    /// \notes The documentation entities of the file must not be used afterwards.
+    std::unique_ptr<cppast::cpp_file> release_file();
+
 private:
     doc_cpp_file(std::string output_name, std::string link_name,
                  std::unique_ptr<cppast::cpp_file>                   file,
@@ -688,7 +748,7 @@ private:
         const generation_config& gen_config, const synopsis_config& syn_config,
         const cppast::cpp_entity_index&                     index,
         type_safe::optional_ref<detail::inline_entity_list> inlines,
-        std::unique_ptr<markup::code_block>                 synopsis) const override;
+        const doc_entity&                                   synopsis_entity) const override;
 
     cppast::code_generator::generation_options do_get_generation_options(
         const synopsis_config& config, bool is_main) const override;
@@ -697,6 +757,12 @@ private:
 
     std::string                       output_name_;
     std::unique_ptr<cppast::cpp_file> file_;
+
+    // resolved references of all synopses in the file, nullptr if not documented
+    mutable std::unordered_map<cppast::cpp_entity_id, const doc_entity*> references_;
+    mutable std::shared_mutex                                            references_mutex_;
+
+    friend class detail::markdown_code_generator;
 };
 
 class comment_registry;
@@ -705,26 +771,118 @@ class comment_registry;
 class entity_blacklist
 {
 public:
+    /// The state of the namespace blacklist inside of a namespace.
+    ///
+    /// It is computed from the state of the enclosing namespace,
+    /// so blacklisted namespaces can be matched while traversing the hierarchy.
+    class scope_state
+    {
+    public:
+        /// \effects Creates the state of the global scope.
+        scope_state() noexcept : blacklisted_(false) {}
+
+        /// \returns Whether or not the namespace itself is blacklisted.
+        bool is_blacklisted() const noexcept
+        {
+            return blacklisted_;
+        }
+
+    private:
+        // the nodes of the blacklisted names whose prefix ends in this namespace
+        std::vector<std::size_t> prefixes_;
+        bool                     blacklisted_;
+
+        friend entity_blacklist;
+    };
+
     /// \effects Creates a blacklist that blacklists private entities.
     entity_blacklist() : entity_blacklist(false) {}
 
     /// \effects Creates a blacklist that may blacklist private entities.
-    explicit entity_blacklist(bool extract_private) : extract_private_(extract_private) {}
+    explicit entity_blacklist(bool extract_private) : nodes_(1u), extract_private_(extract_private)
+    {}
 
     /// \effects Blacklist a namespace name.
     /// It can either be a single name like `detail` or a nested one like `foo::bar`.
-    void blacklist_namespace(std::string name)
-    {
-        ns_blacklist_.emplace(std::move(name));
-    }
+    void blacklist_namespace(const std::string& name);
+
+    /// \returns The state inside the namespace given the state of the enclosing scope.
+    /// \notes Unnamed namespaces do not change the state.
+    scope_state enter_namespace(const scope_state&           parent,
+                                const cppast::cpp_namespace& ns) const;
 
     /// \returns Whether or not the given entity is blacklisted according to this blacklist.
+    /// \notes For namespaces it has to walk all enclosing namespaces,
+    /// prefer [*enter_namespace]() when traversing the hierarchy.
     bool is_blacklisted(const cppast::cpp_entity&         entity,
                         cppast::cpp_access_specifier_kind access) const;
 
 private:
-    std::unordered_set<std::string> ns_blacklist_;
-    bool                            extract_private_;
+    // a trie of the components of the blacklisted namespace names
+    struct node
+    {
+        std::unordered_map<std::string, std::size_t> children;
+        bool                                         blacklisted = false;
+    };
+
+    std::vector<node> nodes_;
+    bool              extract_private_;
+};
+
+/// Caches whether or not base classes are excluded.
+///
+/// Whether a base class is excluded depends on all of its parents,
+/// so it is cached for all derived classes in all files.
+/// \notes It must only be shared between calls to [standardese::exclude_entities]()
+/// with the same registry, index, blacklist and `hide_uncommented` flag.
+class base_exclusion_cache
+{
+public:
+    /// \returns Whether or not the base class is excluded,
+    /// given the access and comment of the base specifier.
+    /// \effects Invokes `f` to compute it, if it isn't cached yet.
+    /// \notes This function is thread-safe.
+    template <typename Func>
+    bool lookup(const cppast::cpp_entity& base, cppast::cpp_access_specifier_kind access,
+                bool commented, bool documented, Func f) const
+    {
+        key k{&base, (unsigned(access) << 2u) | (unsigned(commented) << 1u) | unsigned(documented)};
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto                                iter = map_.find(k);
+            if (iter != map_.end())
+                return iter->second;
+        }
+
+        // computing it twice doesn't matter, the result is the same
+        auto result = f();
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        map_.emplace(k, result);
+        return result;
+    }
+
+private:
+    struct key
+    {
+        const cppast::cpp_entity* base;
+        unsigned                  flags;
+
+        bool operator==(const key& other) const noexcept
+        {
+            return base == other.base && flags == other.flags;
+        }
+    };
+
+    struct key_hash
+    {
+        std::size_t operator()(const key& k) const noexcept
+        {
+            return std::hash<const cppast::cpp_entity*>()(k.base) ^ k.flags;
+        }
+    };
+
+    mutable std::shared_mutex                       mutex_;
+    mutable std::unordered_map<key, bool, key_hash> map_;
 };
 
 /// Excludes all entities that need excluding.
@@ -732,6 +890,13 @@ private:
 void exclude_entities(const comment_registry& registry, const cppast::cpp_entity_index& index,
                       const entity_blacklist& blacklist, bool hide_uncommented, const cppast::cpp_file& file);
 
+/// Excludes all entities that need excluding,
+/// sharing the exclusion of base classes with other files.
+/// \notes This must be called before [standardese::build_doc_entities]() for all files.
+void exclude_entities(const comment_registry& registry, const cppast::cpp_entity_index& index,
+                      const entity_blacklist& blacklist, bool hide_uncommented,
+                      const cppast::cpp_file& file, const base_exclusion_cache& cache);
+
 /// Creates the [standardese::doc_entity]() hierarchy.
 /// \effects Traverses over all entities in the file, builds matching doc entities and marks
 /// excluded entities. \returns The corresponding documentation file. \notes The file output name is
@@ -131,6 +131,10 @@ public:
     /// \notes This function is thread safe.
     void register_module(markup::module_documentation::builder doc) const;
 
+    /// \returns Whether or not a module of the given name has been registered.
+    /// \notes This function is thread safe.
+    bool is_registered(const std::string& module) const;
+
     /// \effects Registers an entity for the given module.
     /// \returns Whether or not there was a module already.
     /// If `false`, this function had no effect.
@@ -151,9 +155,16 @@ private:
 
 class comment_registry;
 
+/// Registers the documentation of all modules the entities in the file belong to.
+/// \effects Modules that are registered already are skipped,
+/// so the documentation of each module is only built once.
+void register_modules(const module_index& index, const comment_registry& registry,
+                      const cppast::cpp_file& file);
+
 /// Registers all entities in a module for the corresponding module.
-void register_module_entities(const module_index& index, const comment_registry& registry,
-                              const cppast::cpp_file& file);
+/// \requires The modules must have been registered by [standardese::register_modules]().
+/// \notes This function is thread safe.
+void register_module_entities(const module_index& index, const cppast::cpp_file& file);
 } // namespace standardese
 
 #endif // STANDARDESE_INDEX_HPP_INCLUDED
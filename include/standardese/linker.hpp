@@ -5,10 +5,12 @@
 #ifndef STANDARDESE_LINKER_HPP_INCLUDED
 #define STANDARDESE_LINKER_HPP_INCLUDED
 
-#include <map>
-#include <mutex>
+#include <iosfwd>
+#include <shared_mutex>
 #include <stdexcept>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <type_safe/variant.hpp>
 
@@ -33,7 +35,14 @@ namespace markup
 class linker
 {
 public:
-    void register_external(std::string namespace_name, std::string url);
+    /// \effects Creates a linker without any external documentation.
+    linker() : external_doc_(1u) {}
+
+    /// \effects Registers the documentation of an external namespace.
+    /// All links to entities in that namespace resolve to the given URL,
+    /// where each `$$` is replaced by the link name.
+    /// If multiple registered namespaces match a link, the innermost one is used.
+    void register_external(const std::string& namespace_name, const std::string& url);
 
     /// \effects Registers the given documentation under a certain name.
     /// All unresolved links with that name will resolve to the given documentation.
@@ -43,6 +52,20 @@ public:
     bool register_documentation(std::string link_name, const markup::document_entity& document,
                                 const markup::block_id& documentation, bool force = false) const;
 
+    /// \effects Writes all registered documentations as link table to the stream.
+    /// Another linker can import it to link to this documentation without parsing it.
+    /// `extension` is the file extension of the documentation files that are linked to.
+    /// \requires The stream must be opened in binary mode.
+    /// \notes The table stores offsets instead of pointers,
+    /// so it can be used directly from memory without any parsing.
+    void export_link_table(std::ostream& out, const std::string& extension) const;
+
+    /// \effects Imports a link table written by `export_link_table()`.
+    /// Link names that are not registered in this linker are then looked up in the table,
+    /// the URLs of those links start with `url_prefix`.
+    /// \throws [std::runtime_error]() if the table is malformed.
+    void import_link_table(std::string table, std::string url_prefix);
+
     /// \returns A reference to the documentation for the given linke name, if there is any.
     /// \notes This function is thread safe.
     type_safe::variant<type_safe::nullvar_t, markup::block_reference, markup::url>
@@ -50,10 +73,27 @@ public:
                              std::string                                       link_name) const;
 
 private:
-    mutable std::mutex                                               mutex_;
+    type_safe::optional<markup::url> lookup_imported(const std::string& link_name) const;
+
+    mutable std::shared_mutex                                        mutex_;
     mutable std::unordered_map<std::string, markup::block_reference> map_;
 
-    std::map<std::string, std::string> external_doc_;
+    // trie of the scopes of external namespaces, the root is the global scope
+    struct external_node
+    {
+        std::unordered_map<std::string, std::size_t> children;
+        std::vector<std::string> url; // split at `$$`, empty if the namespace is not registered
+    };
+
+    std::vector<external_node> external_doc_;
+
+    struct link_table
+    {
+        std::string data; // as written by export_link_table()
+        std::string url_prefix;
+    };
+
+    std::vector<link_table> imported_;
 };
 
 /// Registers all documentations in a document.
@@ -66,8 +106,8 @@ void register_documentations(const cppast::diagnostic_logger& logger, const link
 /// Resolves all unresolved links in a document.
 /// \effects For all [standardese::markup::documentation_link]() entities that are not yet resolved,
 /// uses the linker to resolve them.
-/// \notes This function is *not* thread safe and must be called after the linker is entirely
-/// populated.
+/// \notes This function is thread safe as long as different documents are passed,
+/// but it must be called after the linker is entirely populated.
 void resolve_links(const cppast::diagnostic_logger& logger, const linker& l,
                    const markup::document_entity& document);
 } // namespace standardese
@@ -5,6 +5,8 @@
 #ifndef STANDARDESE_MARKUP_CODE_BLOCK_HPP_INCLUDED
 #define STANDARDESE_MARKUP_CODE_BLOCK_HPP_INCLUDED
 
+#include <cstdint>
+
 #include <standardese/markup/block.hpp>
 #include <standardese/markup/phrasing.hpp>
 
@@ -112,7 +114,69 @@ namespace markup
         /// \group code_block_entity
         using preprocessor = code_block_entity<preprocessor_tag>;
 
+        /// The kind of a token in a code block.
+        enum class token_kind : unsigned char
+        {
+            text,
+            soft_break,
+            keyword,
+            identifier,
+            string_literal,
+            int_literal,
+            float_literal,
+            punctuation,
+            preprocessor,
+
+            entity, //< Any other phrasing entity, e.g. a link.
+        };
+
+        /// A token of a code block.
+        ///
+        /// It is a lightweight view into the code block.
+        class token
+        {
+        public:
+            /// \returns The kind of token.
+            token_kind kind() const noexcept
+            {
+                return kind_;
+            }
+
+            /// \returns The null-terminated string of the token.
+            /// \requires `kind()` must not be `token_kind::entity`.
+            const char* c_str() const noexcept
+            {
+                return str_;
+            }
+
+            /// \returns The phrasing entity of the token.
+            /// \requires `kind()` must be `token_kind::entity`.
+            const phrasing_entity& entity() const noexcept
+            {
+                return *entity_;
+            }
+
+        private:
+            token(token_kind kind, const char* str) noexcept
+            : kind_(kind), str_(str), entity_(nullptr)
+            {}
+
+            explicit token(const phrasing_entity& e) noexcept
+            : kind_(token_kind::entity), str_(nullptr), entity_(&e)
+            {}
+
+            token_kind             kind_;
+            const char*            str_;
+            const phrasing_entity* entity_;
+
+            friend code_block;
+        };
+
         /// Builds a code block.
+        ///
+        /// Text, soft breaks and the syntax highlighting entities are not stored as separate
+        /// entities, but packed into a single buffer.
+        /// Only the remaining phrasing entities become children of the code block.
         class builder : public container_builder<code_block>
         {
         public:
@@ -121,15 +185,44 @@ namespace markup
             : container_builder(
                   std::unique_ptr<code_block>(new code_block(std::move(id), std::move(lang))))
             {}
+
+            /// \effects Adds a token of the given kind.
+            /// Consecutive text tokens are merged.
+            /// \requires `kind` must not be `token_kind::entity` and `str` must not contain null
+            /// characters.
+            builder& add_token(token_kind kind, const char* str, std::size_t length);
+
+            /// \effects Adds a token of the given kind.
+            /// \requires `kind` must not be `token_kind::entity`.
+            builder& add_token(token_kind kind, const char* str)
+            {
+                return add_token(kind, str, std::char_traits<char>::length(str));
+            }
+
+            /// \effects Adds the entity as token,
+            /// it becomes a child only if it cannot be packed.
+            builder& add_child(std::unique_ptr<phrasing_entity> entity);
         };
 
         /// \returns A new code block containing only the given string.
         static std::unique_ptr<code_block> build(block_id id, std::string language,
                                                  std::string code)
         {
-            return builder(std::move(id), std::move(language))
-                .add_child(text::build(std::move(code)))
-                .finish();
+            builder b(std::move(id), std::move(language));
+            b.add_token(token_kind::text, code.c_str(), code.size());
+            return b.finish();
+        }
+
+        /// \effects Invokes the function with every [*token]() of the code block, in order.
+        template <typename Func>
+        void for_each_token(Func f) const
+        {
+            auto child = begin();
+            for (auto& span : spans_)
+                if (span.kind == token_kind::entity)
+                    f(token(*child++));
+                else
+                    f(token(span.kind, buffer_.c_str() + span.offset));
         }
 
         /// \returns The language of the code block.
@@ -149,7 +242,15 @@ namespace markup
 
         std::unique_ptr<entity> do_clone() const override;
 
-        std::string lang_;
+        struct token_span
+        {
+            std::uint32_t offset, length; // into buffer_, unused for entities
+            token_kind    kind;
+        };
+
+        std::string             buffer_; // null-separated token strings
+        std::vector<token_span> spans_;
+        std::string             lang_;
     };
 } // namespace markup
 } // namespace standardese
@@ -4,8 +4,10 @@
 
 #include <cassert>
 #include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 #include <stack>
+#include <type_traits>
 
 #include <standardese/comment.hpp>
 
@@ -37,7 +39,7 @@ bool comment_registry::register_comment(type_safe::object_ref<const cppast::cpp_
     else
     {
         auto& stored_comment = iter->second;
-        if (stored_comment.brief_section() || !stored_comment.sections().empty())
+        if (stored_comment.has_sections())
             // already have a documentation
             return false;
 
@@ -98,38 +100,91 @@ cppast::diagnostic make_semantic_diagnostic(const cppast::cpp_entity& entity, Ar
     return make_diagnostic(cppast::source_location::make_entity(entity.name()),
                            std::forward<Args>(args)...);
 }
-template <class Inline>
-type_safe::optional<comment::unmatched_doc_comment> find_inline(comment::parse_result& result,
-                                                                const Inline&          entity)
+
+// the inline comments of an entity, indexed by kind and name
+class inline_index
 {
-    auto iter = std::find_if(result.inlines.begin(), result.inlines.end(),
-                             [&](const comment::unmatched_doc_comment& comment) {
-                                 return comment.entity == entity;
-                             });
-    if (iter == result.inlines.end())
-        return type_safe::nullopt;
+public:
+    explicit inline_index(type_safe::optional<comment::parse_result>& comment)
+    : inlines_(comment ? &comment.value().inlines : nullptr)
+    {
+        if (!inlines_)
+            return;
 
-    auto comment = std::move(*iter);
-    result.inlines.erase(iter);
-    return std::move(comment);
-}
+        // if names are duplicated, the first comment is matched first
+        for (auto i = std::size_t(0); i != inlines_->size(); ++i)
+        {
+            auto& entity = (*inlines_)[i].entity;
+            if (auto param = comment::get_inline_param(entity))
+                params_.emplace(std::move(param.value()), i);
+            else if (auto base = comment::get_inline_base(entity))
+                bases_.emplace(std::move(base.value()), i);
+        }
+        matched_.resize(inlines_->size(), false);
+    }
+
+    bool empty() const noexcept
+    {
+        return params_.empty() && bases_.empty();
+    }
+
+    // Inline is either inline_param or inline_base
+    template <class Inline>
+    type_safe::optional<comment::doc_comment> match(const std::string& name)
+    {
+        return match(std::is_same<Inline, comment::inline_base>::value ? bases_ : params_, name);
+    }
+
+    // removes the matched comments, the remaining ones keep their order
+    void erase_matched()
+    {
+        if (!inlines_)
+            return;
+
+        inlines_->erase(std::remove_if(inlines_->begin(), inlines_->end(),
+                                       [&](const comment::unmatched_doc_comment& inl) {
+                                           return matched_[std::size_t(&inl - inlines_->data())];
+                                       }),
+                        inlines_->end());
+    }
+
+private:
+    using name_map = std::unordered_map<std::string, std::size_t>;
+
+    type_safe::optional<comment::doc_comment> match(name_map& map, const std::string& name)
+    {
+        auto iter = map.find(name);
+        if (iter == map.end())
+            return type_safe::nullopt;
+
+        auto index = iter->second;
+        map.erase(iter);
+        matched_[index] = true;
+        return std::move((*inlines_)[index].comment);
+    }
+
+    std::vector<comment::unmatched_doc_comment>* inlines_;
+    name_map                                     params_, bases_;
+    std::vector<bool>                            matched_;
+};
 
 template <class Inline, class InlineContainer, typename MatchRegister, typename UnmatchRegister>
-void process_inlines(type_safe::optional<comment::parse_result>& comment,
-                     const InlineContainer& container, const MatchRegister& register_commented,
+void process_inlines(inline_index& index, const InlineContainer& container,
+                     const MatchRegister&   register_commented,
                      const UnmatchRegister& register_uncommented)
 {
     auto cur = 0;
     for (auto& child : container)
     {
-        // create corresponding matching entity
-        Inline name(child.name().empty() ? std::to_string(cur) : child.name());
-        auto   inline_comment = comment.map(
-            [&](comment::parse_result& comment) { return find_inline(comment, name); });
+        // unnamed children are matched by their index
+        type_safe::optional<comment::doc_comment> inline_comment;
+        if (!index.empty())
+            inline_comment = child.name().empty() ? index.match<Inline>(std::to_string(cur))
+                                                  : index.match<Inline>(child.name());
 
         // register
         if (inline_comment)
-            register_commented(type_safe::ref(child), std::move(inline_comment.value().comment));
+            register_commented(type_safe::ref(child), std::move(inline_comment.value()));
         else
             register_uncommented(type_safe::ref(child));
 
@@ -143,18 +198,20 @@ void process_inlines(const cppast::diagnostic_logger&            logger,
                      const cppast::cpp_entity& entity, const MatchRegister& register_commented,
                      const UnmatchRegister& register_uncommented)
 {
+    inline_index index(comment);
     if (auto macro = detail::get_macro(entity))
-        process_inlines<comment::inline_param>(comment, macro.value().parameters(),
+        process_inlines<comment::inline_param>(index, macro.value().parameters(),
                                                register_commented, register_uncommented);
     if (auto func = detail::get_function(entity))
-        process_inlines<comment::inline_param>(comment, func.value().parameters(),
+        process_inlines<comment::inline_param>(index, func.value().parameters(),
                                                register_commented, register_uncommented);
     if (auto templ = detail::get_template(entity))
-        process_inlines<comment::inline_param>(comment, templ.value().parameters(),
+        process_inlines<comment::inline_param>(index, templ.value().parameters(),
                                                register_commented, register_uncommented);
     if (auto c = detail::get_class(entity))
-        process_inlines<comment::inline_base>(comment, c.value().bases(), register_commented,
+        process_inlines<comment::inline_base>(index, c.value().bases(), register_commented,
                                               register_uncommented);
+    index.erase_matched();
 
     // error on remaining inlines
     if (comment)
@@ -179,6 +236,10 @@ void process_inlines(const cppast::diagnostic_logger&            logger,
 
 void file_comment_parser::parse(type_safe::object_ref<const cppast::cpp_file> file) const
 {
+    // parents are visited before their children and their comments are registered by then,
+    // so their unique names can be cached for the entire file
+    unique_name_cache names;
+
     // add matched comments
     cppast::visit(*file, [&](const cppast::cpp_entity& entity, const cppast::visitor_info& info) {
         if (info.event == cppast::visitor_info::container_entity_exit)
@@ -188,10 +249,10 @@ void file_comment_parser::parse(type_safe::object_ref<const cppast::cpp_file> fi
         {
             auto register_commented = [&](type_safe::object_ref<const cppast::cpp_entity> e,
                                           comment::doc_comment                            comment) {
-                this->register_commented(e, std::move(comment));
+                this->register_commented(e, std::move(comment), true, type_safe::ref(names));
             };
             auto register_uncommented = [&](type_safe::object_ref<const cppast::cpp_entity> e) {
-                this->register_uncommented(e);
+                this->register_uncommented(e, names);
             };
 
             // parse comment
@@ -254,7 +315,7 @@ void file_comment_parser::parse(type_safe::object_ref<const cppast::cpp_file> fi
             std::unique_lock<std::mutex> lock(mutex_);
             free_comments_.push_back(std::move(comment));
         }
-        else if (comment::is_file(comment.entity) || config_.free_file_comments())
+        else if (comment::is_file(comment.entity) || config_->free_file_comments())
         {
             // comment for current file
             if (!register_commented(file, std::move(comment.comment.value())))
@@ -270,7 +331,7 @@ void file_comment_parser::parse(type_safe::object_ref<const cppast::cpp_file> fi
 comment_registry file_comment_parser::finish()
 {
     resolve_free_comments();
-    if (config_.group_uncommented())
+    if (config_->group_uncommented())
         group_uncommented();
     return std::move(registry_);
 }
@@ -388,7 +449,7 @@ void file_comment_parser::group_uncommented()
                 // Do not implicitly assign a group if this member already has one.
                 return;
 
-            if (target_comment.has_value() && (target_comment.value().brief_section().has_value() || !target_comment.value().sections().empty()))
+            if (target_comment.has_value() && target_comment.value().has_sections())
                 // Do not implicitly assign a group if this member already has some comment.
                 return;
 
@@ -427,9 +488,10 @@ void file_comment_parser::group_uncommented()
 }
 
 bool file_comment_parser::register_commented(type_safe::object_ref<const cppast::cpp_entity> entity,
-                                             comment::doc_comment comment, bool allow_cmd) const
+                                             comment::doc_comment comment, bool allow_cmd,
+                                             type_safe::optional_ref<unique_name_cache> names) const
 {
-    auto cmd_comment = !comment.brief_section() && comment.sections().empty();
+    auto cmd_comment = !comment.has_sections();
 
     std::lock_guard<std::mutex> lock(mutex_);
     if (comment.metadata().group())
@@ -438,7 +500,9 @@ bool file_comment_parser::register_commented(type_safe::object_ref<const cppast:
 
     if (cmd_comment && allow_cmd)
         // a pure "command" comment, allow later sections
-        uncommented_.emplace(lookup_unique_name(registry_, *entity), &*entity);
+        uncommented_.emplace(names ? lookup_unique_name(registry_, *entity, names.value())
+                                   : lookup_unique_name(registry_, *entity),
+                             &*entity);
 
     return result;
 }
@@ -557,64 +621,62 @@ std::string get_full_unique_name(const std::string& parent, const cppast::cpp_en
 }
 
 template <class Lookup>
-std::string lookup_parent_unique_name(const Lookup& get_comment, const cppast::cpp_entity& e)
-{
-    auto parent = e.parent();
-    while (parent && (cppast::is_templated(parent.value()) || cppast::is_friended(parent.value())))
-        parent = parent.value().parent();
-    if (!parent)
-        return "";
+std::string lookup_parent_unique_name(const Lookup& get_comment, const cppast::cpp_entity& e,
+                                      type_safe::optional_ref<unique_name_cache> cache);
 
+template <class Lookup>
+std::string compute_parent_unique_name(const Lookup& get_comment, const cppast::cpp_entity& parent,
+                                       type_safe::optional_ref<unique_name_cache> cache)
+{
     // don't need unique name for parents that don't have a scope
     // except for functions or templates, those are fine
-    auto need_name = parent.value().scope_name() || detail::get_function(parent.value())
-                     || detail::get_template(parent.value());
+    auto need_name = parent.scope_name() || detail::get_function(parent)
+                     || detail::get_template(parent);
     if (!need_name)
         return "";
 
+    auto comment = parent.scope_name() || detail::get_function(parent) ? get_comment(parent)
+                                                                       : type_safe::nullopt;
     auto result
-        = parent
-              .map([&](const cppast::cpp_entity& p) {
-                  return p.scope_name() || detail::get_function(p) ? get_comment(p)
-                                                                   : type_safe::nullopt;
-              })
-              .map([](const comment::doc_comment& c) { return c.metadata().unique_name(); });
+        = comment.map([](const comment::doc_comment& c) { return c.metadata().unique_name(); });
     if (result)
         return result.value();
 
     // parent doesn't have a unique name
-    return get_full_unique_name(lookup_parent_unique_name(get_comment, parent.value()),
-                                parent.value(), get_unique_name(parent.value()));
+    return get_full_unique_name(lookup_parent_unique_name(get_comment, parent, cache), parent,
+                                get_unique_name(parent));
 }
-} // namespace
 
-void file_comment_parser::register_uncommented(
-    type_safe::object_ref<const cppast::cpp_entity> entity) const
+template <class Lookup>
+std::string lookup_parent_unique_name(const Lookup& get_comment, const cppast::cpp_entity& e,
+                                      type_safe::optional_ref<unique_name_cache> cache)
 {
-    auto unique_name
-        = get_full_unique_name(get_parent_unique_name(*entity), *entity, get_unique_name(*entity));
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    uncommented_.emplace(std::move(unique_name), &*entity);
+    auto parent = e.parent();
+    while (parent && (cppast::is_templated(parent.value()) || cppast::is_friended(parent.value())))
+        parent = parent.value().parent();
+    if (!parent)
+        return "";
+    else if (!cache)
+        return compute_parent_unique_name(get_comment, parent.value(), cache);
+
+    // all children of a parent share its name, so only compute it once
+    if (auto cached = cache.value().lookup(parent.value()))
+        return cached.value();
+    return cache.value().insert(parent.value(),
+                                compute_parent_unique_name(get_comment, parent.value(), cache));
 }
 
-std::string file_comment_parser::get_parent_unique_name(const cppast::cpp_entity& e) const
+std::string calculate_unique_name(const comment_registry& registry, const cppast::cpp_entity& e,
+                                  type_safe::optional_ref<unique_name_cache> cache)
 {
-    return lookup_parent_unique_name([&](const cppast::cpp_entity& e) { return get_comment(e); },
-                                     e);
-}
+    auto get_comment = [&](const cppast::cpp_entity& e) { return registry.get_comment(e); };
 
-std::string standardese::lookup_unique_name(const comment_registry&   registry,
-                                            const cppast::cpp_entity& e)
-{
     auto comment = registry.get_comment(e);
     if (comment && comment.value().metadata().unique_name())
     {
         if (is_relative_unique_name(comment.value().metadata().unique_name().value()))
         {
-            auto parent = lookup_parent_unique_name([&](const cppast::cpp_entity&
-                                                            e) { return registry.get_comment(e); },
-                                                    e);
+            auto parent = lookup_parent_unique_name(get_comment, e, cache);
             return get_full_unique_name(parent, e,
                                         comment.value().metadata().unique_name().value().substr(1));
         }
@@ -623,8 +685,36 @@ std::string standardese::lookup_unique_name(const comment_registry&   registry,
     }
 
     // calculate unique name
-    auto parent = lookup_parent_unique_name([&](const cppast::cpp_entity&
-                                                    e) { return registry.get_comment(e); },
-                                            e);
+    auto parent = lookup_parent_unique_name(get_comment, e, cache);
     return get_full_unique_name(parent, e, get_unique_name(e));
 }
+} // namespace
+
+void file_comment_parser::register_uncommented(
+    type_safe::object_ref<const cppast::cpp_entity> entity, unique_name_cache& names) const
+{
+    auto unique_name = get_full_unique_name(get_parent_unique_name(*entity, names), *entity,
+                                            get_unique_name(*entity));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uncommented_.emplace(std::move(unique_name), &*entity);
+}
+
+std::string file_comment_parser::get_parent_unique_name(const cppast::cpp_entity& e,
+                                                        unique_name_cache&        names) const
+{
+    return lookup_parent_unique_name([&](const cppast::cpp_entity& e) { return get_comment(e); },
+                                     e, type_safe::ref(names));
+}
+
+std::string standardese::lookup_unique_name(const comment_registry&   registry,
+                                            const cppast::cpp_entity& e)
+{
+    return calculate_unique_name(registry, e, nullptr);
+}
+
+std::string standardese::lookup_unique_name(const comment_registry&   registry,
+                                            const cppast::cpp_entity& e, unique_name_cache& cache)
+{
+    return calculate_unique_name(registry, e, type_safe::ref(cache));
+}
@@ -27,20 +27,58 @@ doc_comment standardese::comment::merge(metadata data, doc_comment&& other)
     if (!data.output_section() && other_data.output_section())
         data.set_output_section(other_data.output_section().value());
 
-    return doc_comment(std::move(data), std::move(other.brief_), std::move(other.sections_));
+    return doc_comment(std::move(data), std::move(other.sections_));
+}
+
+comment::detail::owned_sections comment::detail::comment_sections::take() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!config_)
+        // built directly, so it cannot be parsed again
+        return clone();
+
+    if (!parsed_)
+        parse();
+
+    owned_sections result;
+    result.brief    = std::move(brief_);
+    result.sections = std::move(sections_);
+    sections_.clear();
+    parsed_ = false;
+    return result;
+}
+
+comment::detail::owned_sections comment::detail::comment_sections::copy() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!parsed_)
+        parse();
+    return clone();
+}
+
+comment::detail::owned_sections comment::detail::comment_sections::clone() const
+{
+    owned_sections result;
+    if (brief_)
+        result.brief = markup::clone(*brief_);
+    result.sections.reserve(sections_.size());
+    for (auto& sec : sections_)
+        result.sections.push_back(markup::clone(*sec));
+    return result;
 }
 
 namespace
 {
 template <class Builder>
-void set_sections_impl(Builder& builder, const doc_comment& comment)
+void add_sections(Builder& builder, comment::detail::owned_sections owned)
 {
-    if (comment.brief_section())
-        builder.add_brief(markup::clone(comment.brief_section().value()));
+    if (owned.brief)
+        builder.add_brief(std::move(owned.brief));
 
-    for (auto& sec : comment.sections())
+    for (auto& sec : owned.sections)
     {
-        auto ptr = sec.clone().release();
+        auto ptr = sec.release();
         if (ptr->kind() == markup::entity_kind::details_section)
             builder.add_details(std::unique_ptr<markup::details_section>(
                 static_cast<markup::details_section*>(ptr)));
@@ -54,6 +92,12 @@ void set_sections_impl(Builder& builder, const doc_comment& comment)
             assert(false);
     }
 }
+
+template <class Builder>
+void set_sections_impl(Builder& builder, const doc_comment& comment)
+{
+    add_sections(builder, comment.take_sections());
+}
 } // namespace
 
 void standardese::comment::set_sections(standardese::markup::entity_documentation::builder& builder,
@@ -79,3 +123,9 @@ void standardese::comment::set_sections(markup::module_documentation::builder& b
 {
     set_sections_impl(builder, comment);
 }
+
+void standardese::comment::copy_sections(markup::namespace_documentation::builder& builder,
+                                         const doc_comment&                        comment)
+{
+    add_sections(builder, comment.copy_sections());
+}
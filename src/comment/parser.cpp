@@ -30,25 +30,32 @@
 using namespace standardese;
 using namespace standardese::comment;
 
-parser::parser(comment::config c)
-: config_(std::move(c)), parser_(cmark_parser_new(CMARK_OPT_SMART))
-{
-    verbatim_extension::verbatim_extension::create(parser_);
-    ignore_html_extension::ignore_html_extension::create(parser_);
-    command_extension::command_extension::create(parser_, config_);
-}
+parser::parser(comment::config c) : parser(std::make_shared<const comment::config>(std::move(c))) {}
 
-parser::~parser() noexcept
+namespace
+{
+void free_parser(cmark_parser* parser) noexcept
 {
-    auto cur = cmark_parser_get_syntax_extensions(parser_);
+    auto cur = cmark_parser_get_syntax_extensions(parser);
     while (cur)
     {
         cmark_syntax_extension_free(cmark_get_default_mem_allocator(),
                                     static_cast<cmark_syntax_extension*>(cur->data));
         cur = cur->next;
     }
-    cmark_parser_free(parser_);
+    cmark_parser_free(parser);
 }
+} // namespace
+
+parser::parser(std::shared_ptr<const comment::config> c)
+: config_(std::move(c)), parser_(cmark_parser_new(CMARK_OPT_SMART), &free_parser)
+{
+    verbatim_extension::verbatim_extension::create(parser_.get());
+    ignore_html_extension::ignore_html_extension::create(parser_.get());
+    command_extension::command_extension::create(parser_.get(), *config_);
+}
+
+parser::~parser() noexcept = default;
 
 namespace
 {
@@ -81,6 +88,14 @@ public:
         return root_;
     }
 
+    /// \effects Gives up the ownership of the node.
+    cmark_node* release() noexcept
+    {
+        auto root = root_;
+        root_     = nullptr;
+        return root;
+    }
+
 private:
     cmark_node* root_;
 };
@@ -636,6 +651,65 @@ void add_child(short, Builder&, std::unique_ptr<T>)
     assert(!static_cast<bool>("unexpected child"));
 }
 
+// checks the node and its children without building them
+void check_node(cmark_node* node)
+{
+    if (cmark_node_get_type(node) == verbatim_extension::verbatim_extension::node_type())
+        // children aren't parsed
+        return;
+
+    switch (cmark_node_get_type(node))
+    {
+    case CMARK_NODE_HTML_BLOCK:
+    case CMARK_NODE_HTML_INLINE:
+    case CMARK_NODE_CUSTOM_BLOCK:
+    case CMARK_NODE_CUSTOM_INLINE:
+    case CMARK_NODE_IMAGE:
+    case CMARK_NODE_FOOTNOTE_DEFINITION:
+    case CMARK_NODE_FOOTNOTE_REFERENCE:
+        error(node, std::string("forbidden CommonMark node of type \"")
+                        + cmark_node_get_type_string(node) + "\"");
+        break;
+
+    default:
+        for (auto cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
+            check_node(cur);
+        break;
+    }
+}
+
+// handles the commands and inlines of the comment but only checks the sections
+// returns whether or not there are any sections
+bool add_metadata(const config& c, comment_builder& builder, bool has_matching_entity,
+                  cmark_node* root)
+{
+    using extension = command_extension::command_extension;
+
+    auto has_sections = false, has_brief = false;
+    for (auto cur = cmark_node_first_child(root); cur; cur = cmark_node_next(cur))
+    {
+        if (cmark_node_get_type(cur) == extension::node_type<section_type>())
+        {
+            const auto& data = command_extension::user_data<section_type>::get(cur);
+            if (data.command == section_type::brief && has_brief)
+                error(nullptr, "multiple brief sections for comment");
+            else if (data.command == section_type::brief)
+                has_brief = true;
+
+            check_node(cur);
+            has_sections = true;
+        }
+        else if (cmark_node_get_type(cur) == extension::node_type<command_type>())
+            parse_command(builder, has_matching_entity, cur);
+        else if (cmark_node_get_type(cur) == extension::node_type<inline_type>())
+            parse_inline(c, builder, has_matching_entity, cur);
+        else
+            check_node(cur);
+    }
+
+    return has_sections;
+}
+
 template <class Builder>
 void add_children(const config& c, Builder& b, bool has_matching_entity, cmark_node* parent)
 {
@@ -719,16 +793,60 @@ void add_children(const config& c, Builder& b, bool has_matching_entity, cmark_n
 }
 } // namespace
 
+comment::detail::comment_sections::~comment_sections() noexcept
+{
+    if (root_)
+        cmark_node_free(root_);
+}
+
+void comment::detail::comment_sections::parse() const
+{
+    if (!config_)
+        // built directly
+        return;
+
+    comment_builder builder;
+    if (root_)
+    {
+        // the AST of comment::parse() is only needed for the first access
+        ast_root root(root_);
+        root_ = nullptr;
+        add_children(*config_, builder, has_matching_entity_, root.get());
+    }
+    else
+    {
+        // the sections have been taken, so parse them again
+        comment::parser p(config_);
+        auto            root = read_ast(p, text_);
+        add_children(p.config(), builder, has_matching_entity_, root.get());
+    }
+    // the nodes are gone, so are their references to the syntax extensions
+    parser_.reset();
+
+    brief_    = std::move(builder.brief);
+    sections_ = std::move(builder.sections);
+    parsed_   = true;
+}
+
 parse_result comment::parse(const parser& p, const std::string& comment, bool has_matching_entity)
 {
     auto root = read_ast(p, comment);
 
+    // the sections are only built when needed
     comment_builder builder;
-    add_children(p.config(), builder, has_matching_entity, root.get());
+    auto has_sections = add_metadata(p.config(), builder, has_matching_entity, root.get());
 
-    if (builder.brief || !builder.sections.empty() || !builder.data.is_empty())
-        return parse_result{doc_comment(std::move(builder.data), std::move(builder.brief),
-                                        std::move(builder.sections)),
+    if (has_sections)
+    {
+        // the sections will be built from the AST
+        doc_comment result(std::move(builder.data), p.shared_config(), comment, p.shared_parser(),
+                           root.get(), has_matching_entity);
+        root.release();
+        return parse_result{std::move(result), std::move(builder.entity),
+                            std::move(builder.inlines)};
+    }
+    else if (!builder.data.is_empty())
+        return parse_result{doc_comment(std::move(builder.data), nullptr, {}),
                             std::move(builder.entity), std::move(builder.inlines)};
     else
         return parse_result{type_safe::nullopt, std::move(builder.entity),
@@ -5,8 +5,11 @@
 #include <standardese/doc_entity.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <condition_variable>
+#include <exception>
 #include <stack>
 
 #include <cppast/cpp_entity_kind.hpp>
@@ -64,7 +67,7 @@ doc_excluded_entity parent_excluded_entity;
 /// Return whether this comment provides meaningful documentation.
 bool is_documenting(const comment::doc_comment& comment)
 {
-    return comment.brief_section() || !comment.sections().empty();
+    return comment.has_sections();
 }
 
 /// Return whether this entity has meaningful documentation.
@@ -222,9 +225,10 @@ class standardese::detail::markdown_code_generator : public cppast::code_generat
 {
 public:
     markdown_code_generator(type_safe::object_ref<const synopsis_config>          config,
-                            type_safe::object_ref<const cppast::cpp_entity_index> index)
-    : config_(config), index_(index), builder_(markup::block_id(), "cpp"), level_(0u),
-      need_indent_(false), allow_group_(false), render_injected_(false)
+                            type_safe::object_ref<const cppast::cpp_entity_index> index,
+                            type_safe::optional_ref<const doc_cpp_file>           file)
+    : config_(config), index_(index), file_(file), builder_(markup::block_id(), "cpp"),
+      level_(0u), need_indent_(false), allow_group_(false), render_injected_(false)
     {}
 
     std::unique_ptr<markup::code_block> finish()
@@ -355,19 +359,19 @@ private:
     void do_write_token_seq(cppast::string_view tokens) override
     {
         update_indent();
-        builder_.add_child(markup::text::build(tokens.c_str()));
+        builder_.add_token(markup::code_block::token_kind::text, tokens.c_str());
     }
 
     void do_write_keyword(cppast::string_view keyword) override
     {
         update_indent();
-        builder_.add_child(markup::code_block::keyword::build(keyword.c_str()));
+        builder_.add_token(markup::code_block::token_kind::keyword, keyword.c_str());
     }
 
     void write_identifier(cppast::string_view identifier)
     {
         if (identifier.length() > 0u)
-            builder_.add_child(markup::code_block::identifier::build(identifier.c_str()));
+            builder_.add_token(markup::code_block::token_kind::identifier, identifier.c_str());
     }
 
     bool write_link(const doc_entity& entity, cppast::string_view name)
@@ -410,56 +414,77 @@ private:
     {
         update_indent();
 
-        auto entity = index_->lookup(id[0u]); // pick first if overloaded
+        if (auto doc_e = lookup_reference(id[0u])) // pick first if overloaded
+            return write_link(*doc_e, name);
+        else
+            write_identifier(name);
+
+        return true;
+    }
+
+    const doc_entity* lookup_reference(const cppast::cpp_entity_id& id) const
+    {
+        if (file_)
+        {
+            // the same entities are referenced over and over again
+            std::shared_lock<std::shared_mutex> lock(file_.value().references_mutex_);
+            auto iter = file_.value().references_.find(id);
+            if (iter != file_.value().references_.end())
+                return iter->second;
+        }
+
+        auto entity = index_->lookup(id);
         if (!entity)
         {
-            auto ns = index_->lookup_namespace(id[0u]);
+            auto ns = index_->lookup_namespace(id);
             if (ns.size() > 0u)
                 entity = ns[0u];
         }
 
-        if (entity && get_doc_entity(entity.value()))
-            return write_link(*get_doc_entity(entity.value()), name);
-        else
-            write_identifier(name);
-
-        return true;
+        auto result = entity ? get_doc_entity(entity.value()) : nullptr;
+        if (file_)
+        {
+            std::unique_lock<std::shared_mutex> lock(file_.value().references_mutex_);
+            file_.value().references_.emplace(id, result);
+        }
+        return result;
     }
 
     void do_write_punctuation(cppast::string_view punct) override
     {
         update_indent();
-        builder_.add_child(markup::code_block::punctuation::build(punct.c_str()));
+        builder_.add_token(markup::code_block::token_kind::punctuation, punct.c_str());
     }
 
     void do_write_str_literal(cppast::string_view str) override
     {
         update_indent();
-        builder_.add_child(markup::code_block::string_literal::build(str.c_str()));
+        builder_.add_token(markup::code_block::token_kind::string_literal, str.c_str());
     }
 
     void do_write_int_literal(cppast::string_view str) override
     {
         update_indent();
-        builder_.add_child(markup::code_block::int_literal::build(str.c_str()));
+        builder_.add_token(markup::code_block::token_kind::int_literal, str.c_str());
     }
 
     void do_write_float_literal(cppast::string_view str) override
     {
         update_indent();
-        builder_.add_child(markup::code_block::float_literal::build(str.c_str()));
+        builder_.add_token(markup::code_block::token_kind::float_literal, str.c_str());
     }
 
     void do_write_preprocessor(cppast::string_view punct) override
     {
         update_indent();
-        builder_.add_child(markup::code_block::preprocessor::build(punct.c_str()));
+        builder_.add_token(markup::code_block::token_kind::preprocessor, punct.c_str());
     }
 
     void write_excluded()
     {
         update_indent();
-        builder_.add_child(markup::code_block::identifier::build(config_->hidden_name()));
+        builder_.add_token(markup::code_block::token_kind::identifier,
+                           config_->hidden_name().c_str());
     }
 
     void do_write_excluded(const cppast::cpp_entity&) override
@@ -469,26 +494,32 @@ private:
 
     void do_write_newline() override
     {
-        builder_.add_child(markup::soft_break::build());
+        builder_.add_token(markup::code_block::token_kind::soft_break, "\n", 1u);
         need_indent_.set();
     }
 
     void do_write_whitespace() override
     {
         update_indent();
-        builder_.add_child(markup::text::build(" "));
+        builder_.add_token(markup::code_block::token_kind::text, " ", 1u);
     }
 
     void update_indent()
     {
-        if (need_indent_.try_reset())
-            builder_.add_child(markup::text::build(std::string(level_, ' ')));
+        if (need_indent_.try_reset() && level_ > 0u)
+        {
+            if (indent_.size() < level_)
+                indent_.resize(level_, ' ');
+            builder_.add_token(markup::code_block::token_kind::text, indent_.c_str(), level_);
+        }
     }
 
     type_safe::object_ref<const synopsis_config>          config_;
     type_safe::object_ref<const cppast::cpp_entity_index> index_;
+    type_safe::optional_ref<const doc_cpp_file>           file_;
 
     markup::code_block::builder builder_;
+    std::string                 indent_; // at least level_ spaces
 
     std::stack<type_safe::object_ref<const cppast::cpp_entity>> entities_;
 
@@ -498,6 +529,21 @@ private:
     type_safe::flag render_injected_;
 };
 
+namespace
+{
+type_safe::optional_ref<const doc_cpp_file> get_file(const doc_entity& entity)
+{
+    auto cur = type_safe::ref(entity);
+    while (cur->kind() != doc_entity::cpp_file && cur->parent())
+        cur = type_safe::ref(cur->parent().value());
+
+    if (cur->kind() == doc_entity::cpp_file)
+        return type_safe::ref(static_cast<const doc_cpp_file&>(*cur));
+    else
+        return nullptr;
+}
+} // namespace
+
 std::unique_ptr<markup::code_block> standardese::generate_synopsis(
     const synopsis_config& config, const cppast::cpp_entity_index& index, const doc_entity& entity)
 {
@@ -506,7 +552,8 @@ std::unique_ptr<markup::code_block> standardese::generate_synopsis(
         return generate_synopsis(config, index, entity.parent().value());
     else
     {
-        detail::markdown_code_generator generator(type_safe::ref(config), type_safe::ref(index));
+        detail::markdown_code_generator generator(type_safe::ref(config), type_safe::ref(index),
+                                                  get_file(entity));
         entity.do_generate_code(generator);
         return generator.finish();
     }
@@ -762,6 +809,16 @@ markup::documentation_header get_header(const cppast::cpp_entity&
                                                               : type_safe::nullopt);
 }
 
+bool is_inline_entity(const cppast::cpp_entity& e)
+{
+    return e.kind() == cppast::cpp_function_parameter::kind()
+           || e.kind() == cppast::cpp_macro_parameter::kind() || cppast::is_parameter(e.kind())
+           || e.kind() == cppast::cpp_base_class::kind()
+           || e.kind() == cppast::cpp_enum_value::kind()
+           || e.kind() == cppast::cpp_member_variable::kind()
+           || e.kind() == cppast::cpp_bitfield::kind();
+}
+
 bool empty_sections(type_safe::optional_ref<const comment::doc_comment> comment)
 {
     if (comment)
@@ -774,12 +831,14 @@ std::unique_ptr<markup::term_description_item> get_inline_doc(
     markup::block_id id, const cppast::cpp_entity& e,
     type_safe::optional_ref<const comment::doc_comment> comment)
 {
-    if (comment && comment.value().brief_section())
+    auto owned = comment ? comment.value().take_sections() : comment::detail::owned_sections();
+    if (owned.brief)
     {
         auto term = markup::term::build(markup::code::build(get_entity_name(false, e)));
 
+        // the brief is owned now, so the copy of its children is the only one
         markup::description::builder description;
-        for (auto& phrasing : comment.value().brief_section().value())
+        for (auto& phrasing : *owned.brief)
             description.add_child(markup::clone(phrasing));
 
         return markup::term_description_item::build(std::move(id), std::move(term),
@@ -794,26 +853,128 @@ std::unique_ptr<markup::documentation_entity> standardese::generate_documentatio
     const generation_config& gen_config, const synopsis_config& syn_config,
     const cppast::cpp_entity_index& index, const doc_entity& entity)
 {
-    return entity.do_generate_documentation(gen_config, syn_config, index, nullptr,
-                                            generate_synopsis(syn_config, index, entity));
+    return entity.do_generate_documentation(gen_config, syn_config, index, nullptr, entity);
+}
+
+namespace
+{
+std::unique_ptr<markup::entity_documentation> as_entity_documentation(
+    std::unique_ptr<markup::documentation_entity> doc)
+{
+    if (!doc)
+        return nullptr;
+    assert(doc->kind() == markup::entity_kind::entity_documentation);
+    return std::unique_ptr<markup::entity_documentation>(
+        static_cast<markup::entity_documentation*>(doc.release()));
 }
 
+// state shared between the calling thread and the tasks of the executor
+class child_generation
+{
+public:
+    child_generation(const generation_config& gen_config, const synopsis_config& syn_config,
+                     const cppast::cpp_entity_index& index, const doc_entity& parent)
+    : gen_config_(gen_config), syn_config_(syn_config), index_(index)
+    {
+        for (auto& child : parent)
+            children_.push_back(&child);
+        results_.resize(children_.size());
+    }
+
+    std::size_t size() const noexcept
+    {
+        return children_.size();
+    }
+
+    // generates children until there are none left
+    void run() noexcept
+    {
+        for (auto i = next_++; i < children_.size(); i = next_++)
+        {
+            try
+            {
+                results_[i] = as_entity_documentation(
+                    generate_documentation(gen_config_, syn_config_, index_, *children_[i]));
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!exception_)
+                    exception_ = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (++finished_ == children_.size())
+                cv_.notify_all();
+        }
+    }
+
+    // waits until all children are generated
+    // and returns their documentation in the original order
+    std::vector<std::unique_ptr<markup::entity_documentation>> finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] { return finished_ == children_.size(); });
+        if (exception_)
+            std::rethrow_exception(exception_);
+        return std::move(results_);
+    }
+
+private:
+    const generation_config&        gen_config_;
+    const synopsis_config&          syn_config_;
+    const cppast::cpp_entity_index& index_;
+
+    std::vector<const doc_entity*>                             children_;
+    std::vector<std::unique_ptr<markup::entity_documentation>> results_;
+    std::atomic<std::size_t>                                   next_{0u};
+
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+    std::size_t             finished_ = 0u;
+    std::exception_ptr      exception_;
+};
+
+// generates the documentation of all children, possibly in parallel
+// the result contains null pointers for children without documentation
+std::vector<std::unique_ptr<markup::entity_documentation>> generate_child_documentation(
+    const generation_config& gen_config, const synopsis_config& syn_config,
+    const cppast::cpp_entity_index& index, const doc_entity& parent)
+{
+    auto state = std::make_shared<child_generation>(gen_config, syn_config, index, parent);
+    if (gen_config.get_executor() && gen_config.parallel_threshold() != 0u
+        && state->size() >= gen_config.parallel_threshold())
+    {
+        // tasks that are started after all children are claimed return immediately,
+        // but they keep the state alive
+        // nested containers start tasks as well, so there aren't more than there are threads
+        auto no_tasks = std::min(state->size() - 1u, gen_config.executor_threads());
+        for (auto i = std::size_t(0); i != no_tasks; ++i)
+            gen_config.get_executor()([state] { state->run(); });
+    }
+
+    state->run();
+    return state->finish();
+}
+} // namespace
+
 std::unique_ptr<markup::documentation_entity> doc_cpp_entity::do_generate_documentation(
     const generation_config& gen_config, const synopsis_config& syn_config,
     const cppast::cpp_entity_index&                     index,
     type_safe::optional_ref<detail::inline_entity_list> inlines,
-    std::unique_ptr<markup::code_block>                 synopsis) const
+    const doc_entity&                                   synopsis_entity) const
 {
-    auto inline_doc
-        = gen_config.is_flag_set(generation_config::inline_doc) && empty_sections(comment());
-
     if (group_member_no_.value_or(1u) != 1u || get_documentation_id().as_str() != link_name())
         // not a main entity that needs documentation
         return nullptr;
+
+    // checking the sections builds them, so only do it for entities that can be inline
+    auto inline_doc = gen_config.is_flag_set(generation_config::inline_doc)
+                      && is_inline_entity(entity()) && empty_sections(comment());
     // various inline entities
-    else if (inline_doc
-             && (entity().kind() == cppast::cpp_function_parameter::kind()
-                 || entity().kind() == cppast::cpp_macro_parameter::kind()))
+    if (inline_doc
+        && (entity().kind() == cppast::cpp_function_parameter::kind()
+            || entity().kind() == cppast::cpp_macro_parameter::kind()))
         inlines.value().params.add_item(
             get_inline_doc(get_documentation_id(), entity(), comment()));
     else if (inline_doc && cppast::is_parameter(entity().kind()))
@@ -830,23 +991,26 @@ std::unique_ptr<markup::documentation_entity> doc_cpp_entity::do_generate_docume
                  || entity().kind() == cppast::cpp_bitfield::kind()))
         inlines.value().members.add_item(
             get_inline_doc(get_documentation_id(), entity(), comment()));
+    else if (!comment() && !gen_config.is_flag_set(generation_config::document_uncommented)
+             && begin() == end())
+        // no documentation at all, so don't bother generating the synopsis
+        return nullptr;
     // non-inline entity
     else
     {
         markup::entity_documentation::builder builder(entity_, get_documentation_id(),
                                                       get_header(*entity_, comment(),
                                                                  get_entity_name(true, *entity_)),
-                                                      std::move(synopsis));
+                                                      generate_synopsis(syn_config, index,
+                                                                        synopsis_entity));
         if (comment())
             comment::set_sections(builder, comment().value());
 
         detail::inline_entity_list my_inlines(link_name());
         for (auto& child : *this)
         {
-            auto child_doc
-                = child.do_generate_documentation(gen_config, syn_config, index,
-                                                  type_safe::ref(my_inlines),
-                                                  generate_synopsis(syn_config, index, child));
+            auto child_doc = child.do_generate_documentation(gen_config, syn_config, index,
+                                                             type_safe::ref(my_inlines), child);
             if (child_doc)
             {
                 assert(child_doc->kind() == markup::entity_kind::entity_documentation);
@@ -882,7 +1046,7 @@ std::unique_ptr<markup::documentation_entity> doc_cpp_entity::do_generate_docume
 
 std::unique_ptr<markup::documentation_entity> doc_metadata_entity::do_generate_documentation(
     const generation_config&, const synopsis_config&, const cppast::cpp_entity_index&,
-    type_safe::optional_ref<detail::inline_entity_list>, std::unique_ptr<markup::code_block>) const
+    type_safe::optional_ref<detail::inline_entity_list>, const doc_entity&) const
 {
     return nullptr;
 }
@@ -891,31 +1055,22 @@ std::unique_ptr<markup::documentation_entity> doc_member_group_entity::do_genera
     const generation_config& gen_config, const synopsis_config& syn_config,
     const cppast::cpp_entity_index&                     index,
     type_safe::optional_ref<detail::inline_entity_list> inlines,
-    std::unique_ptr<markup::code_block>                 synopsis) const
+    const doc_entity&                                   synopsis_entity) const
 {
+    // the synopsis is the one of the group
     return begin()->do_generate_documentation(gen_config, syn_config, index, inlines,
-                                              std::move(synopsis));
+                                              synopsis_entity);
 }
 
 std::unique_ptr<markup::documentation_entity> doc_cpp_namespace::do_generate_documentation(
     const generation_config& gen_config, const synopsis_config& syn_config,
-    const cppast::cpp_entity_index&     index, type_safe::optional_ref<detail::inline_entity_list>,
-    std::unique_ptr<markup::code_block> synopsis) const
+    const cppast::cpp_entity_index& index, type_safe::optional_ref<detail::inline_entity_list>,
+    const doc_entity&               synopsis_entity) const
 {
     // generate child documentation
-    std::vector<std::unique_ptr<markup::entity_documentation>> child_docs;
-    for (auto& child : *this)
-    {
-        auto child_doc
-            = child.do_generate_documentation(gen_config, syn_config, index, nullptr,
-                                              generate_synopsis(syn_config, index, child));
-        if (child_doc)
-        {
-            assert(child_doc->kind() == markup::entity_kind::entity_documentation);
-            child_docs.push_back(std::unique_ptr<markup::entity_documentation>(
-                static_cast<markup::entity_documentation*>(child_doc.release())));
-        }
-    }
+    auto child_docs = generate_child_documentation(gen_config, syn_config, index, *this);
+    child_docs.erase(std::remove(child_docs.begin(), child_docs.end(), nullptr),
+                     child_docs.end());
 
     if (child_docs.empty() && comment())
     {
@@ -923,7 +1078,8 @@ std::unique_ptr<markup::documentation_entity> doc_cpp_namespace::do_generate_doc
         markup::entity_documentation::builder builder(entity_, get_documentation_id(),
                                                       get_header(namespace_(), comment(),
                                                                  namespace_().name()),
-                                                      std::move(synopsis));
+                                                      generate_synopsis(syn_config, index,
+                                                                        synopsis_entity));
         comment::set_sections(builder, comment().value());
 
         return builder.finish();
@@ -947,33 +1103,26 @@ markup::namespace_documentation::builder doc_cpp_namespace::get_builder() const
                                                                 get_entity_name(true,
                                                                                 namespace_())));
     if (comment())
-        comment::set_sections(builder, comment().value());
+        // the sections are taken when generating the documentation of the namespace
+        comment::copy_sections(builder, comment().value());
     return builder;
 }
 
 std::unique_ptr<markup::documentation_entity> doc_cpp_file::do_generate_documentation(
     const generation_config& gen_config, const synopsis_config& syn_config,
-    const cppast::cpp_entity_index&     index, type_safe::optional_ref<detail::inline_entity_list>,
-    std::unique_ptr<markup::code_block> synopsis) const
+    const cppast::cpp_entity_index& index, type_safe::optional_ref<detail::inline_entity_list>,
+    const doc_entity&               synopsis_entity) const
 {
     markup::file_documentation::builder builder(type_safe::ref(*file_), get_documentation_id(),
                                                 get_header(*file_, comment(), output_name()),
-                                                std::move(synopsis));
+                                                generate_synopsis(syn_config, index,
+                                                                  synopsis_entity));
     if (comment())
         comment::set_sections(builder, comment().value());
 
-    for (auto& child : *this)
-    {
-        auto child_doc
-            = child.do_generate_documentation(gen_config, syn_config, index, nullptr,
-                                              generate_synopsis(syn_config, index, child));
+    for (auto& child_doc : generate_child_documentation(gen_config, syn_config, index, *this))
         if (child_doc)
-        {
-            assert(child_doc->kind() == markup::entity_kind::entity_documentation);
-            builder.add_child(std::unique_ptr<markup::entity_documentation>(
-                static_cast<markup::entity_documentation*>(child_doc.release())));
-        }
-    }
+            builder.add_child(std::move(child_doc));
 
     return builder.finish();
 }
@@ -1016,6 +1165,33 @@ doc_cpp_file::builder::builder(std::string output_name, std::string link_name,
     peek().file().set_user_data(&peek());
 }
 
+std::unique_ptr<cppast::cpp_file> doc_cpp_file::release_file()
+{
+    auto reset = [](const cppast::cpp_entity& entity) { entity.set_user_data(nullptr); };
+    cppast::visit(*file_, [&](const cppast::cpp_entity& entity, const cppast::visitor_info& info) {
+        if (info.is_old_entity())
+            return;
+
+        reset(entity);
+
+        // the inline entities are not visited, but have user data as well
+        if (auto templ = detail::get_template(entity))
+            for (auto& param : templ.value().parameters())
+                reset(param);
+        if (auto macro = detail::get_macro(entity))
+            for (auto& param : macro.value().parameters())
+                reset(param);
+        if (auto func = detail::get_function(entity))
+            for (auto& param : func.value().parameters())
+                reset(param);
+        if (auto c = detail::get_class(entity))
+            for (auto& base : c.value().bases())
+                reset(base);
+    });
+
+    return std::move(file_);
+}
+
 namespace
 {
 bool is_virtual(const cppast::cpp_entity& e)
@@ -1044,6 +1220,49 @@ bool is_friend_func_def(const cppast::cpp_entity& e)
 }
 } // namespace
 
+void entity_blacklist::blacklist_namespace(const std::string& name)
+{
+    auto cur = std::size_t(0);
+    for (auto begin = std::size_t(0); begin <= name.size();)
+    {
+        auto end = std::min(name.find("::", begin), name.size());
+
+        auto result = nodes_[cur].children.emplace(name.substr(begin, end - begin), nodes_.size());
+        if (result.second)
+            nodes_.emplace_back();
+        cur = result.first->second;
+
+        begin = end + 2u;
+    }
+    nodes_[cur].blacklisted = true;
+}
+
+entity_blacklist::scope_state entity_blacklist::enter_namespace(
+    const scope_state& parent, const cppast::cpp_namespace& ns) const
+{
+    if (ns.name().empty())
+        // unnamed namespaces are not part of blacklisted names
+        return parent;
+
+    scope_state result;
+    auto        match = [&](std::size_t node) {
+        auto iter = nodes_[node].children.find(ns.name());
+        if (iter != nodes_[node].children.end())
+        {
+            result.prefixes_.push_back(iter->second);
+            if (nodes_[iter->second].blacklisted)
+                result.blacklisted_ = true;
+        }
+    };
+
+    // a blacklisted name can start in this namespace or continue a prefix of the parent
+    match(0u);
+    for (auto node : parent.prefixes_)
+        match(node);
+
+    return result;
+}
+
 bool entity_blacklist::is_blacklisted(const cppast::cpp_entity&         entity,
                                       cppast::cpp_access_specifier_kind access) const
 {
@@ -1052,24 +1271,16 @@ bool entity_blacklist::is_blacklisted(const cppast::cpp_entity&         entity,
         return true;
     else if (entity.kind() == cppast::cpp_namespace::kind())
     {
-        auto name = entity.name();
-        if (ns_blacklist_.count(name))
-            return true;
-
+        std::vector<const cppast::cpp_namespace*> namespaces;
+        namespaces.push_back(static_cast<const cppast::cpp_namespace*>(&entity));
         for (auto cur = entity.parent(); cur; cur = cur.value().parent())
-        {
-            auto scope = cur.value().scope_name();
-            if (scope
-                // Do not prepend a "::" for unnamed namespaces
-                && scope.value().name() != "")
-            {
-                name = scope.value().name() + "::" + name;
-                if (ns_blacklist_.count(name))
-                    return true;
-            }
-        }
+            if (cur.value().kind() == cppast::cpp_namespace::kind())
+                namespaces.push_back(static_cast<const cppast::cpp_namespace*>(&cur.value()));
 
-        return false;
+        scope_state state;
+        for (auto iter = namespaces.rbegin(); iter != namespaces.rend(); ++iter)
+            state = enter_namespace(state, **iter);
+        return state.is_blacklisted();
     }
     else
         return false;
@@ -1124,10 +1335,11 @@ bool is_class(const cppast::cpp_entity& e)
 }
 
 bool is_excluded(const cppast::cpp_entity& e, cppast::cpp_access_specifier_kind access,
-                 type_safe::optional_ref<const comment::doc_comment> comment,
-                 const cppast::cpp_entity_index& index, const entity_blacklist& blacklist, bool hide_uncommented)
+                 bool blacklisted, type_safe::optional_ref<const comment::doc_comment> comment,
+                 const cppast::cpp_entity_index& index, const entity_blacklist& blacklist, bool hide_uncommented,
+                 const base_exclusion_cache& cache)
 {
-    if (blacklist.is_blacklisted(e, access))
+    if (blacklisted)
         return true;
     else if (!comment && (is_class(e) || e.kind() == cppast::cpp_entity_kind::enum_t)
              && !cppast::is_definition(e))
@@ -1154,16 +1366,20 @@ bool is_excluded(const cppast::cpp_entity& e, cppast::cpp_access_specifier_kind
         auto& base = static_cast<const cppast::cpp_base_class&>(e);
         if (auto entity = cppast::get_class_or_typedef(index, base))
         {
-            auto cur = entity;
-            while (cur)
-            {
-                auto excluded = is_excluded(cur.value(), access, comment, index, blacklist, hide_uncommented);
-                if (excluded)
-                    return true;
-                cur = cur.value().parent();
-            }
-
-            return false;
+            auto is_scope_excluded = [&] {
+                for (auto cur = entity; cur; cur = cur.value().parent())
+                    if (is_excluded(cur.value(), access,
+                                    blacklist.is_blacklisted(cur.value(), access), comment, index,
+                                    blacklist, hide_uncommented, cache))
+                        return true;
+                return false;
+            };
+
+            // an explicit \exclude was handled above,
+            // so it only depends on whether there is a documenting comment
+            return cache.lookup(entity.value(), access, comment.has_value(),
+                                comment.has_value() && is_documenting(comment.value()),
+                                is_scope_excluded);
         }
         else
             return false;
@@ -1209,6 +1425,7 @@ bool is_ignored(const cppast::cpp_entity& e)
 
 std::unique_ptr<doc_entity> build_entity(const comment_registry&         registry,
                                          const cppast::cpp_entity_index& index,
+                                         unique_name_cache&              names,
                                          const cppast::cpp_entity&       e);
 
 type_safe::optional_ref<const cppast::cpp_class> is_excluded_base(
@@ -1262,13 +1479,14 @@ void handle_bases(const Visitor& visitor, const comment_registry& registry,
 
 std::unique_ptr<doc_cpp_entity> build_cpp_entity(const comment_registry&         registry,
                                                  const cppast::cpp_entity_index& index,
+                                                 unique_name_cache&              names,
                                                  const cppast::cpp_entity&       e)
 {
-    auto                    link_name = lookup_unique_name(registry, e);
+    auto                    link_name = lookup_unique_name(registry, e, names);
     doc_cpp_entity::builder builder(link_name, type_safe::ref(e), registry.get_comment(e));
 
     auto visitor = [&](const cppast::cpp_entity& entity, bool injected) {
-        if (auto child = build_entity(registry, index, entity))
+        if (auto child = build_entity(registry, index, names, entity))
         {
             if (injected)
                 child->mark_injected();
@@ -1296,6 +1514,7 @@ std::unique_ptr<doc_cpp_entity> build_cpp_entity(const comment_registry&
 
 std::unique_ptr<doc_metadata_entity> build_metadata_entity(const comment_registry&         registry,
                                                            const cppast::cpp_entity_index& index,
+                                                           unique_name_cache&              names,
                                                            const cppast::cpp_entity&       e)
 {
     auto comment = registry.get_comment(e);
@@ -1304,7 +1523,7 @@ std::unique_ptr<doc_metadata_entity> build_metadata_entity(const comment_registr
 
     doc_metadata_entity::builder builder(type_safe::ref(e), type_safe::ref(comment.value()));
     detail::visit_children(e, [&](const cppast::cpp_entity& entity) {
-        if (auto child = build_entity(registry, index, entity))
+        if (auto child = build_entity(registry, index, names, entity))
             builder.add_child(std::move(child));
     });
     return builder.finish();
@@ -1312,6 +1531,7 @@ std::unique_ptr<doc_metadata_entity> build_metadata_entity(const comment_registr
 
 std::unique_ptr<doc_member_group_entity> build_member_group(const comment_registry& registry,
                                                             const cppast::cpp_entity_index& index,
+                                                            unique_name_cache&        names,
                                                             const std::string&        group_name,
                                                             const cppast::cpp_entity& e)
 {
@@ -1334,20 +1554,21 @@ std::unique_ptr<doc_member_group_entity> build_member_group(const comment_regist
         // e is the main entity, so build group
         doc_member_group_entity::builder builder(group_name);
         for (auto& member : group)
-            builder.add_member(build_cpp_entity(registry, index, *member));
+            builder.add_member(build_cpp_entity(registry, index, names, *member));
         return builder.finish();
     }
 }
 
 std::unique_ptr<doc_cpp_namespace> build_namespace(const comment_registry&         registry,
                                                    const cppast::cpp_entity_index& index,
+                                                   unique_name_cache&              names,
                                                    const cppast::cpp_namespace&    ns)
 {
-    doc_cpp_namespace::builder builder(lookup_unique_name(registry, ns), type_safe::ref(ns),
+    doc_cpp_namespace::builder builder(lookup_unique_name(registry, ns, names), type_safe::ref(ns),
                                        registry.get_comment(ns));
 
     detail::visit_children(ns, [&](const cppast::cpp_entity& entity) {
-        if (auto child = build_entity(registry, index, entity))
+        if (auto child = build_entity(registry, index, names, entity))
             builder.add_child(std::move(child));
     });
 
@@ -1382,6 +1603,7 @@ bool build_is_excluded(const cppast::cpp_entity_index& index, const cppast::cpp_
 
 std::unique_ptr<doc_entity> build_entity(const comment_registry&         registry,
                                          const cppast::cpp_entity_index& index,
+                                         unique_name_cache&              names,
                                          const cppast::cpp_entity&       e)
 {
     auto comment = registry.get_comment(e);
@@ -1389,14 +1611,15 @@ std::unique_ptr<doc_entity> build_entity(const comment_registry&         registr
         return nullptr;
     else if (is_ignored(e) || (e.kind() == cppast::cpp_friend::kind() && !is_friend_func_def(e)))
         // those can only be documented as metadata
-        return build_metadata_entity(registry, index, e);
+        return build_metadata_entity(registry, index, names, e);
     else if (e.kind() == cppast::cpp_namespace::kind())
-        return build_namespace(registry, index, static_cast<const cppast::cpp_namespace&>(e));
+        return build_namespace(registry, index, names,
+                               static_cast<const cppast::cpp_namespace&>(e));
     else if (comment.has_value() && comment.value().metadata().group())
-        return build_member_group(registry, index,
+        return build_member_group(registry, index, names,
                                   comment.value().metadata().group().value().name(), e);
     else
-        return build_cpp_entity(registry, index, e);
+        return build_cpp_entity(registry, index, names, e);
 }
 } // namespace
 
@@ -1404,10 +1627,26 @@ void standardese::exclude_entities(const comment_registry&         registry,
                                    const cppast::cpp_entity_index& index,
                                    const entity_blacklist& blacklist, bool hide_uncommented, const cppast::cpp_file& file)
 {
+    base_exclusion_cache cache;
+    exclude_entities(registry, index, blacklist, hide_uncommented, file, cache);
+}
+
+void standardese::exclude_entities(const comment_registry&         registry,
+                                   const cppast::cpp_entity_index& index,
+                                   const entity_blacklist& blacklist, bool hide_uncommented,
+                                   const cppast::cpp_file& file, const base_exclusion_cache& cache)
+{
+    // blacklist state of the enclosing namespaces
+    std::vector<entity_blacklist::scope_state> namespaces(1u);
+
     auto exclude_if_necessary
         = [&](const cppast::cpp_entity& entity, cppast::cpp_access_specifier_kind access) {
+              auto blacklisted = entity.kind() == cppast::cpp_namespace::kind()
+                                     ? namespaces.back().is_blacklisted()
+                                     : blacklist.is_blacklisted(entity, access);
               auto comment = registry.get_comment(entity);
-              if (is_excluded(entity, access, comment, index, blacklist, hide_uncommented))
+              if (is_excluded(entity, access, blacklisted, comment, index, blacklist,
+                              hide_uncommented, cache))
                   entity.set_user_data(&excluded_entity);
               else if (entity.parent() && entity.parent().value().user_data())
                   // parent excluded, so exclude this as well
@@ -1415,6 +1654,16 @@ void standardese::exclude_entities(const comment_registry&         registry,
           };
 
     cppast::visit(file, [&](const cppast::cpp_entity& entity, const cppast::visitor_info& info) {
+        if (entity.kind() == cppast::cpp_namespace::kind())
+        {
+            if (info.event == cppast::visitor_info::container_entity_exit)
+                namespaces.pop_back();
+            else
+                namespaces.push_back(
+                    blacklist.enter_namespace(namespaces.back(),
+                                              static_cast<const cppast::cpp_namespace&>(entity)));
+        }
+
         if (info.is_old_entity())
             return;
 
@@ -1449,8 +1698,10 @@ std::unique_ptr<doc_cpp_file> standardese::build_doc_entities(
     doc_cpp_file::builder builder(std::move(output_name), lookup_unique_name(*registry, f),
                                   std::move(file), comment);
 
+    // the registry is complete, so the unique names of the parents can be cached
+    unique_name_cache names;
     detail::visit_children(f, [&](const cppast::cpp_entity& entity) {
-        if (auto child = build_entity(*registry, index, entity))
+        if (auto child = build_entity(*registry, index, names, entity))
             builder.add_child(std::move(child));
     });
 
@@ -262,6 +262,15 @@ void module_index::register_module(markup::module_documentation::builder doc) co
         modules_.insert(range.first, std::move(doc));
 }
 
+bool module_index::is_registered(const std::string& module) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto                        iter = std::lower_bound(modules_.begin(), modules_.end(), module,
+                                 [](const markup::module_documentation::builder& lhs,
+                                    const std::string& rhs) { return lhs.id().as_str() < rhs; });
+    return iter != modules_.end() && iter->id().as_str() == module;
+}
+
 bool module_index::register_entity(std::string module, std::string link_name,
                                    const cppast::cpp_entity&                            entity,
                                    type_safe::optional_ref<const markup::brief_section> brief) const
@@ -289,52 +298,62 @@ std::unique_ptr<markup::module_index> module_index::generate() const
     return builder.finish();
 }
 
-void standardese::register_module_entities(const module_index&     index,
-                                           const comment_registry& registry,
-                                           const cppast::cpp_file& file)
+namespace
 {
-    auto get_module = [&](const cppast::cpp_entity& e) -> type_safe::optional<std::string> {
-        if (auto doc_e = static_cast<const doc_entity*>(e.user_data()))
-        {
-            if (doc_e->comment())
-                return doc_e->comment().value().metadata().module();
-        }
-
-        return type_safe::nullopt;
-    };
+type_safe::optional<std::string> get_module(const cppast::cpp_entity& e)
+{
+    if (auto doc_e = static_cast<const doc_entity*>(e.user_data()))
+    {
+        if (doc_e->comment())
+            return doc_e->comment().value().metadata().module();
+    }
 
-    auto register_entity = [&](std::string module, const cppast::cpp_entity& e) {
-        assert(e.user_data());
-        auto& doc_e = *static_cast<const doc_entity*>(e.user_data());
-        return index.register_entity(std::move(module), doc_e.link_name(), e,
-                                     doc_e.comment().value().brief_section());
-    };
+    return type_safe::nullopt;
+}
 
-    auto get_module_doc = [&](const std::string& name) {
-        markup::module_documentation::builder builder(markup::block_id(name),
-                                                      markup::heading::builder(markup::block_id())
-                                                          .add_child(markup::text::build("Module "))
-                                                          .add_child(markup::code::build(name))
-                                                          .finish());
+markup::module_documentation::builder get_module_doc(const comment_registry& registry,
+                                                     const std::string&      name)
+{
+    markup::module_documentation::builder builder(markup::block_id(name),
+                                                  markup::heading::builder(markup::block_id())
+                                                      .add_child(markup::text::build("Module "))
+                                                      .add_child(markup::code::build(name))
+                                                      .finish());
 
-        if (auto module_comment = registry.get_comment(name))
-            comment::set_sections(builder, module_comment.value());
+    if (auto module_comment = registry.get_comment(name))
+        comment::set_sections(builder, module_comment.value());
 
-        return builder;
-    };
+    return builder;
+}
+} // namespace
 
+void standardese::register_modules(const module_index& index, const comment_registry& registry,
+                                   const cppast::cpp_file& file)
+{
     cppast::visit(file, [&](const cppast::cpp_entity& e, const cppast::visitor_info& info) {
         if (info.event != cppast::visitor_info::container_entity_exit)
         {
             auto module = get_module(e);
-            if (module && !register_entity(module.value(), e))
-            {
-                // need to register module
-                auto module_doc = get_module_doc(module.value());
-                index.register_module(std::move(module_doc));
+            if (module && !index.is_registered(module.value()))
+                // the module comment is only used once
+                index.register_module(get_module_doc(registry, module.value()));
+        }
 
-                // can register again now
-                auto result = register_entity(module.value(), e);
+        return true;
+    });
+}
+
+void standardese::register_module_entities(const module_index&     index,
+                                           const cppast::cpp_file& file)
+{
+    cppast::visit(file, [&](const cppast::cpp_entity& e, const cppast::visitor_info& info) {
+        if (info.event != cppast::visitor_info::container_entity_exit)
+        {
+            if (auto module = get_module(e))
+            {
+                auto& doc_e  = *static_cast<const doc_entity*>(e.user_data());
+                auto  result = index.register_entity(module.value(), doc_e.link_name(), e,
+                                                    doc_e.comment().value().brief_section());
                 assert(result);
             }
         }
@@ -6,6 +6,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <ostream>
+#include <vector>
 
 #include <cppast/cpp_entity.hpp>
 #include <cppast/cpp_file.hpp>
@@ -18,14 +21,48 @@
 #include <standardese/markup/documentation.hpp>
 #include <standardese/markup/entity_kind.hpp>
 #include <standardese/markup/index.hpp>
+#include <standardese/markup/visitor.hpp>
 
 #include "get_special_entity.hpp"
 
 using namespace standardese;
 
-void linker::register_external(std::string namespace_name, std::string url)
+namespace
+{
+std::vector<std::string> split_url(const std::string& url)
+{
+    std::vector<std::string> result(1u);
+
+    for (auto iter = url.begin(); iter != url.end(); ++iter)
+    {
+        if (*iter == '$' && iter != std::prev(url.end()) && *++iter == '$')
+            // sequence of two dollar signs
+            result.emplace_back();
+        else
+            result.back() += *iter;
+    }
+
+    return result;
+}
+} // namespace
+
+void linker::register_external(const std::string& namespace_name, const std::string& url)
 {
-    external_doc_[std::move(namespace_name)] = std::move(url);
+    auto cur = std::size_t(0);
+    for (auto begin = std::size_t(0); begin <= namespace_name.size();)
+    {
+        auto end = std::min(namespace_name.find("::", begin), namespace_name.size());
+
+        auto result = external_doc_[cur].children.emplace(namespace_name.substr(begin, end - begin),
+                                                          external_doc_.size());
+        // read before adding the node, which may move the map the result points into
+        cur = result.first->second;
+        if (result.second)
+            external_doc_.emplace_back();
+
+        begin = end + 2u;
+    }
+    external_doc_[cur].url = split_url(url);
 }
 
 namespace
@@ -105,7 +142,7 @@ bool linker::register_documentation(std::string link_name, const markup::documen
     link_name       = process_link_name(std::move(link_name));
     auto short_name = short_link_name(link_name);
 
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
 
     // insert long name
     auto result = map_.emplace(std::move(link_name), ref);
@@ -136,25 +173,188 @@ bool linker::register_documentation(std::string link_name, const markup::documen
 
 namespace
 {
-bool has_scope(const std::string& str, const std::string& scope)
+// layout of a link table, all integers are 32 bit little endian:
+// * header: magic, version, offset of the file extension, number of entries
+// * entries sorted by link name: offsets of link name, document name and block id, flags
+// * strings, each prefixed by its length
+constexpr char          link_table_magic[]  = "SDLT";
+constexpr std::uint32_t link_table_version  = 1u;
+constexpr std::size_t   link_table_header   = 16u;
+constexpr std::size_t   link_table_entry    = 16u;
+constexpr std::uint32_t link_table_need_ext = 1u;
+
+void write_u32(std::string& out, std::uint32_t value)
 {
-    return std::strncmp(str.c_str(), scope.c_str(), scope.size()) == 0 && str[scope.size()] == ':';
+    for (auto i = 0u; i != 4u; ++i)
+        out += static_cast<char>((value >> (8u * i)) & 0xFFu);
 }
 
-markup::url get_url(const std::string& url, const std::string& link_name)
+std::uint32_t read_u32(const std::string& table, std::size_t offset)
 {
-    std::string result;
+    std::uint32_t result = 0u;
+    for (auto i = 0u; i != 4u; ++i)
+        result |= std::uint32_t(static_cast<unsigned char>(table[offset + i])) << (8u * i);
+    return result;
+}
 
-    for (auto iter = url.begin(); iter != url.end(); ++iter)
+std::string read_string(const std::string& table, std::size_t offset)
+{
+    return table.substr(offset + 4u, read_u32(table, offset));
+}
+
+// compares the string at the offset with the given one
+int compare_string(const std::string& table, std::size_t offset, const std::string& str)
+{
+    return table.compare(offset + 4u, read_u32(table, offset), str);
+}
+
+// the strings of a link table, each string is only stored once
+class string_table
+{
+public:
+    // base is the offset of the first string in the table
+    explicit string_table(std::size_t base) : base_(base) {}
+
+    std::uint32_t insert(const std::string& str)
     {
-        if (*iter == '$' && iter != std::prev(url.end()) && *++iter == '$')
-            // sequence of two dollar signs
-            result += link_name;
-        else
-            result += *iter;
+        auto result = offsets_.emplace(str, std::uint32_t(base_ + data_.size()));
+        if (result.second)
+        {
+            write_u32(data_, std::uint32_t(str.size()));
+            data_ += str;
+        }
+        return result.first->second;
+    }
+
+    const std::string& data() const noexcept
+    {
+        return data_;
+    }
+
+private:
+    std::unordered_map<std::string, std::uint32_t> offsets_;
+    std::string                                    data_;
+    std::size_t                                    base_;
+};
+} // namespace
+
+void linker::export_link_table(std::ostream& out, const std::string& extension) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    using entry = std::pair<const std::string, markup::block_reference>;
+    std::vector<const entry*> entries;
+    entries.reserve(map_.size());
+    for (auto& e : map_)
+        entries.push_back(&e);
+    std::sort(entries.begin(), entries.end(),
+              [](const entry* lhs, const entry* rhs) { return lhs->first < rhs->first; });
+
+    string_table strings(link_table_header + entries.size() * link_table_entry);
+
+    std::string table(link_table_magic);
+    write_u32(table, link_table_version);
+    write_u32(table, strings.insert(extension));
+    write_u32(table, std::uint32_t(entries.size()));
+    for (auto e : entries)
+    {
+        // registered references always have a document
+        auto& document = e->second.document().value();
+        write_u32(table, strings.insert(e->first));
+        write_u32(table, strings.insert(document.name()));
+        write_u32(table, strings.insert(e->second.id().as_str()));
+        write_u32(table, document.needs_extension() ? link_table_need_ext : 0u);
     }
+    table += strings.data();
 
-    return markup::url(result);
+    out.write(table.data(), static_cast<std::streamsize>(table.size()));
+}
+
+void linker::import_link_table(std::string table, std::string url_prefix)
+{
+    auto is_string = [&](std::size_t offset) {
+        return offset <= table.size() && table.size() - offset >= 4u
+               && read_u32(table, offset) <= table.size() - offset - 4u;
+    };
+
+    if (table.size() < link_table_header || table.compare(0u, 4u, link_table_magic) != 0
+        || read_u32(table, 4u) != link_table_version || !is_string(read_u32(table, 8u))
+        || read_u32(table, 12u) > (table.size() - link_table_header) / link_table_entry)
+        throw std::runtime_error("invalid link table");
+
+    // validate all entries, so lookups do not need to
+    for (auto i = std::size_t(0); i != read_u32(table, 12u); ++i)
+    {
+        auto entry = link_table_header + i * link_table_entry;
+        if (!is_string(read_u32(table, entry)) || !is_string(read_u32(table, entry + 4u))
+            || !is_string(read_u32(table, entry + 8u)))
+            throw std::runtime_error("invalid link table entry");
+        else if (i > 0u
+                 && compare_string(table, read_u32(table, entry - link_table_entry),
+                                   read_string(table, read_u32(table, entry)))
+                        >= 0)
+            throw std::runtime_error("link table entries are not sorted");
+    }
+
+    imported_.push_back(link_table{std::move(table), std::move(url_prefix)});
+}
+
+type_safe::optional<markup::url> linker::lookup_imported(const std::string& link_name) const
+{
+    for (auto& imported : imported_)
+    {
+        auto& table = imported.data;
+
+        // binary search for the entry
+        auto first = std::size_t(0);
+        auto last  = std::size_t(read_u32(table, 12u));
+        while (first != last)
+        {
+            auto middle = first + (last - first) / 2u;
+            auto entry  = link_table_header + middle * link_table_entry;
+
+            auto result = compare_string(table, read_u32(table, entry), link_name);
+            if (result < 0)
+                first = middle + 1u;
+            else if (result > 0)
+                last = middle;
+            else
+            {
+                auto name     = read_string(table, read_u32(table, entry + 4u));
+                auto document = (read_u32(table, entry + 12u) & link_table_need_ext)
+                                    ? markup::output_name::from_name(std::move(name))
+                                    : markup::output_name::from_file_name(std::move(name));
+                auto id = markup::block_id(read_string(table, read_u32(table, entry + 8u)));
+
+                auto url = imported.url_prefix
+                           + document.file_name(read_string(table, read_u32(table, 8u)).c_str());
+                url += "#standardese-" + id.as_output_str();
+                return markup::url(std::move(url));
+            }
+        }
+    }
+
+    return type_safe::nullopt;
+}
+
+namespace
+{
+markup::url get_url(const std::vector<std::string>& url, const std::string& link_name)
+{
+    auto size = (url.size() - 1u) * link_name.size();
+    for (auto& part : url)
+        size += part.size();
+
+    std::string result;
+    result.reserve(size);
+    result += url.front();
+    for (auto iter = std::next(url.begin()); iter != url.end(); ++iter)
+    {
+        result += link_name;
+        result += *iter;
+    }
+
+    return markup::url(std::move(result));
 }
 
 std::string get_scope_name(const cppast::cpp_entity& entity)
@@ -187,21 +387,43 @@ type_safe::variant<type_safe::nullvar_t, markup::block_reference, markup::url> l
     // performs local lookup
     auto do_lookup = [&](const std::string& link_name)
         -> type_safe::variant<type_safe::nullvar_t, markup::block_reference, markup::url> {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto                        iter = map_.find(process_link_name(link_name));
-        if (iter == map_.end())
-            return type_safe::nullvar;
-        return iter->second;
+        // lookups only read the map, so they can run concurrently
+        auto name = process_link_name(link_name);
+
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto                                iter = map_.find(name);
+        if (iter != map_.end())
+            return iter->second;
+        lock.unlock();
+
+        // link to the documentation of another project
+        if (auto url = lookup_imported(name))
+            return url.value();
+        return type_safe::nullvar;
     };
 
-    auto external_iter = external_doc_.lower_bound(link_name);
-    if (external_iter != external_doc_.begin()
-        && has_scope(link_name, std::prev(external_iter)->first))
+    // find the innermost registered namespace the link name is in
+    type_safe::optional_ref<const std::vector<std::string>> external_url;
+    auto                                                    cur = std::size_t(0);
+    for (auto begin = std::size_t(0);;)
     {
-        // external doc
-        --external_iter;
-        return get_url(external_iter->second, link_name);
+        auto end = link_name.find("::", begin);
+        if (end == std::string::npos)
+            break;
+
+        auto iter = external_doc_[cur].children.find(link_name.substr(begin, end - begin));
+        if (iter == external_doc_[cur].children.end())
+            break;
+        cur = iter->second;
+        if (!external_doc_[cur].url.empty())
+            external_url = type_safe::opt_ref(&external_doc_[cur].url);
+
+        begin = end + 2u;
     }
+
+    if (external_url)
+        // external doc
+        return get_url(external_url.value(), link_name);
     else if (!relative)
         // absolute lookup
         return do_lookup(link_name);
@@ -359,62 +581,102 @@ cppast::source_location get_location(const markup::document_entity&    document,
 }
 } // namespace
 
-void standardese::resolve_links(const cppast::diagnostic_logger& logger, const linker& l,
-                                const markup::document_entity& document)
+namespace
 {
-    auto get_context
-        = [](const markup::entity& entity) -> type_safe::optional_ref<const cppast::cpp_entity> {
-        if (entity.kind() == markup::entity_kind::file_documentation)
-            return type_safe::opt_ref(
-                &static_cast<const markup::file_documentation&>(entity).file());
-        else if (entity.kind() == markup::entity_kind::entity_documentation)
-            return type_safe::opt_ref(
-                &static_cast<const markup::entity_documentation&>(entity).entity());
-        else if (entity.kind() == markup::entity_kind::namespace_documentation)
-            return type_safe::opt_ref(
-                &static_cast<const markup::namespace_documentation&>(entity).namespace_());
+type_safe::optional_ref<const cppast::cpp_entity> get_context(const markup::entity& entity)
+{
+    if (entity.kind() == markup::entity_kind::file_documentation)
+        return type_safe::opt_ref(&static_cast<const markup::file_documentation&>(entity).file());
+    else if (entity.kind() == markup::entity_kind::entity_documentation)
+        return type_safe::opt_ref(
+            &static_cast<const markup::entity_documentation&>(entity).entity());
+    else if (entity.kind() == markup::entity_kind::namespace_documentation)
+        return type_safe::opt_ref(
+            &static_cast<const markup::namespace_documentation&>(entity).namespace_());
+    else
+        return nullptr;
+}
+
+// visits the document while keeping track of the enclosing documentation blocks,
+// so the context of a link does not require walking up the parents
+class link_resolver
+{
+public:
+    link_resolver(const cppast::diagnostic_logger& logger, const linker& l,
+                  const markup::document_entity& document)
+    : logger_(logger), linker_(l), document_(document)
+    {}
+
+    void visit(const markup::entity& entity)
+    {
+        if (markup::is_documentation(entity.kind()))
+        {
+            // note: the context is intentionally not restored on exit,
+            // so index items after a namespace still use it
+            if (auto new_context = get_context(entity))
+                context_ = new_context;
+
+            blocks_.push_back(&static_cast<const markup::documentation_entity&>(entity).id());
+            markup::detail::call_visit(entity, &callback, this);
+            blocks_.pop_back();
+        }
         else
-            return nullptr;
-    };
+        {
+            if (entity.kind() == markup::entity_kind::documentation_link)
+                resolve(static_cast<const markup::documentation_link&>(entity));
+            markup::detail::call_visit(entity, &callback, this);
+        }
+    }
 
-    auto get_documentation_block = [](const markup::entity& entity) {
-        for (auto cur = entity.parent(); cur; cur = cur.value().parent())
-            if (markup::is_documentation(cur.value().kind()))
-                return static_cast<const markup::documentation_entity&>(cur.value()).id();
+private:
+    static void callback(void* mem, const markup::entity& entity)
+    {
+        static_cast<link_resolver*>(mem)->visit(entity);
+    }
 
-        assert(false);
-        return markup::block_id();
-    };
+    const markup::block_id& get_documentation_block() const noexcept
+    {
+        // links outside of any documentation, e.g. in a brief of the entity index
+        static const markup::block_id none;
+        return blocks_.empty() ? none : *blocks_.back();
+    }
 
-    type_safe::optional_ref<const cppast::cpp_entity> context;
-    markup::visit(document, [&](const markup::entity& entity) {
-        if (entity.kind() == markup::entity_kind::documentation_link)
+    void resolve(const markup::documentation_link& link) const
+    {
+        auto unresolved = link.unresolved_destination();
+        if (!unresolved)
+            return;
+
+        auto destination = linker_.lookup_documentation(context_, unresolved.value());
+        if (auto block
+            = destination.optional_value(type_safe::variant_type<markup::block_reference>{}))
         {
-            auto& link = static_cast<const markup::documentation_link&>(entity);
-            if (auto unresolved = link.unresolved_destination())
-            {
-                auto destination = l.lookup_documentation(context, unresolved.value());
-                if (auto block = destination.optional_value(
-                        type_safe::variant_type<markup::block_reference>{}))
-                {
-                    auto same_document = !block.value().document()
-                                         || block.value().document().value().name()
-                                                == document.output_name().name();
-                    if (!same_document
-                        || block.value().id().as_str() != get_documentation_block(entity).as_str())
-                        // only resolve if points to something different
-                        link.resolve_destination(block.value());
-                }
-                else if (auto url
-                         = destination.optional_value(type_safe::variant_type<markup::url>{}))
-                    link.resolve_destination(url.value());
-                else
-                    logger.log("standardese linker",
-                               make_diagnostic(get_location(document, link),
-                                               "unresolved link name '", unresolved.value(), '\''));
-            }
+            auto same_document = !block.value().document()
+                                 || block.value().document().value().name()
+                                        == document_.output_name().name();
+            if (!same_document
+                || block.value().id().as_str() != get_documentation_block().as_str())
+                // only resolve if points to something different
+                link.resolve_destination(block.value());
         }
-        else if (auto new_context = get_context(entity))
-            context = new_context;
-    });
+        else if (auto url = destination.optional_value(type_safe::variant_type<markup::url>{}))
+            link.resolve_destination(url.value());
+        else
+            logger_.log("standardese linker",
+                        make_diagnostic(get_location(document_, link), "unresolved link name '",
+                                        unresolved.value(), '\''));
+    }
+
+    const cppast::diagnostic_logger&                  logger_;
+    const linker&                                     linker_;
+    const markup::document_entity&                    document_;
+    std::vector<const markup::block_id*>              blocks_;
+    type_safe::optional_ref<const cppast::cpp_entity> context_;
+};
+} // namespace
+
+void standardese::resolve_links(const cppast::diagnostic_logger& logger, const linker& l,
+                                const markup::document_entity& document)
+{
+    link_resolver(logger, l, document).visit(document);
 }
@@ -19,23 +19,23 @@ constexpr bool is_digit(char c)
     return c >= '0' && c <= '9';
 }
 
-void escape_char(std::string& str, char c)
+constexpr char escape_char(char c)
 {
     if (is_alpha(c) || is_digit(c) || c == '_' || c == '-')
-        str += c;
+        return c;
     // distinction is somewhat arbitrary
     else if (c == ':')
-        str += '_';
+        return '_';
     else
-        str += '-';
+        return '-';
 }
 } // namespace
 
 std::string block_id::as_output_str() const
 {
-    std::string id;
-    id.reserve(id_.size());
-    for (auto c : id_)
-        escape_char(id, c);
+    // every character is replaced by exactly one character
+    std::string id(id_);
+    for (auto& c : id)
+        c = escape_char(c);
     return id;
 }
@@ -4,6 +4,8 @@
 
 #include <standardese/markup/code_block.hpp>
 
+#include <cassert>
+
 #include <standardese/markup/entity_kind.hpp>
 
 using namespace standardese::markup;
@@ -43,6 +45,75 @@ entity_kind code_block::preprocessor_tag::kind() noexcept
     return entity_kind::code_block_preprocessor;
 }
 
+code_block::builder& code_block::builder::add_token(token_kind kind, const char* str,
+                                                   std::size_t length)
+{
+    assert(kind != token_kind::entity);
+    auto& result = peek();
+
+    if (kind == token_kind::text && !result.spans_.empty()
+        && result.spans_.back().kind == token_kind::text)
+    {
+        // merge with previous text, replacing its null terminator
+        result.buffer_.pop_back();
+        result.spans_.back().length += std::uint32_t(length);
+    }
+    else
+        result.spans_.push_back({std::uint32_t(result.buffer_.size()), std::uint32_t(length), kind});
+
+    result.buffer_.append(str, length);
+    result.buffer_.push_back('\0');
+    return *this;
+}
+
+namespace
+{
+template <class Entity>
+const std::string& get_string(const phrasing_entity& entity)
+{
+    return static_cast<const Entity&>(entity).string();
+}
+} // namespace
+
+code_block::builder& code_block::builder::add_child(std::unique_ptr<phrasing_entity> entity)
+{
+    if (!entity)
+        return *this;
+
+    switch (entity->kind())
+    {
+    case entity_kind::text:
+    {
+        auto& str = get_string<text>(*entity);
+        return add_token(token_kind::text, str.c_str(), str.size());
+    }
+    case entity_kind::soft_break:
+        return add_token(token_kind::soft_break, "\n", 1u);
+
+#define STANDARDESE_DETAIL_HANDLE(Kind)                                                            \
+    case entity_kind::code_block_##Kind:                                                           \
+    {                                                                                              \
+        auto& str = get_string<code_block::Kind>(*entity);                                         \
+        return add_token(token_kind::Kind, str.c_str(), str.size());                               \
+    }
+
+        STANDARDESE_DETAIL_HANDLE(keyword)
+        STANDARDESE_DETAIL_HANDLE(identifier)
+        STANDARDESE_DETAIL_HANDLE(string_literal)
+        STANDARDESE_DETAIL_HANDLE(int_literal)
+        STANDARDESE_DETAIL_HANDLE(float_literal)
+        STANDARDESE_DETAIL_HANDLE(punctuation)
+        STANDARDESE_DETAIL_HANDLE(preprocessor)
+
+#undef STANDARDESE_DETAIL_HANDLE
+
+    default:
+        peek().spans_.push_back({0u, 0u, token_kind::entity});
+        container_builder::add_child(std::move(entity));
+        return *this;
+    }
+}
+
 entity_kind code_block::do_get_kind() const noexcept
 {
     return entity_kind::code_block;
@@ -50,6 +121,7 @@ entity_kind code_block::do_get_kind() const noexcept
 
 void code_block::do_visit(detail::visitor_callback_t cb, void* mem) const
 {
+    // only the entity tokens are actual entities
     for (auto& child : *this)
         cb(mem, child);
 }
@@ -58,6 +130,10 @@ std::unique_ptr<entity> code_block::do_clone() const
 {
     builder b(id(), language());
     for (auto& child : *this)
-        b.add_child(detail::unchecked_downcast<phrasing_entity>(child.clone()));
-    return b.finish();
+        b.container_builder::add_child(detail::unchecked_downcast<phrasing_entity>(child.clone()));
+
+    auto result     = b.finish();
+    result->buffer_ = buffer_;
+    result->spans_  = spans_;
+    return result;
 }
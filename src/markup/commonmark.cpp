@@ -0,0 +1,688 @@
+// Copyright (C) 2016-2019 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include "commonmark.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+using namespace standardese::markup;
+using namespace standardese::markup::detail;
+
+// The rendering rules are the ones of cmark's CommonMark renderer (commonmark.c and render.c),
+// specialized to a width of zero and CMARK_OPT_NOBREAKS.
+
+namespace
+{
+// character classes as in cmark's ctype table
+bool is_space(char c) noexcept
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool is_digit(char c) noexcept
+{
+    return c >= '0' && c <= '9';
+}
+
+bool is_alpha(char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool is_punct(int c) noexcept
+{
+    return (c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96)
+           || (c >= 123 && c <= 126);
+}
+
+bool is_block(cmark_type type) noexcept
+{
+    return type <= cmark_type::thematic_break;
+}
+
+bool can_contain(cmark_type parent, cmark_type child) noexcept
+{
+    switch (parent)
+    {
+    case cmark_type::document:
+    case cmark_type::block_quote:
+    case cmark_type::item:
+        return is_block(child) && child != cmark_type::item && child != cmark_type::document;
+    case cmark_type::list:
+        return child == cmark_type::item;
+
+    case cmark_type::paragraph:
+    case cmark_type::heading:
+    case cmark_type::emph:
+    case cmark_type::strong:
+    case cmark_type::link:
+        return !is_block(child);
+
+    case cmark_type::code_block:
+    case cmark_type::html_block:
+    case cmark_type::thematic_break:
+    case cmark_type::text:
+    case cmark_type::softbreak:
+    case cmark_type::linebreak:
+    case cmark_type::code:
+    case cmark_type::html_inline:
+        break;
+    }
+
+    return false;
+}
+
+// decodes the UTF-8 sequence starting at str
+// returns its length or -1 if it is invalid, like cmark_utf8proc_iterate()
+int decode_utf8(const char* str, std::size_t remaining, int& c) noexcept
+{
+    auto byte = static_cast<unsigned char>(str[0]);
+
+    int length;
+    if (byte < 0x80)
+        length = 1;
+    else if (byte < 0xC0)
+        return -1;
+    else if (byte < 0xE0)
+        length = 2;
+    else if (byte < 0xF0)
+        length = 3;
+    else if (byte < 0xF8)
+        length = 4;
+    else
+        return -1;
+
+    if (std::size_t(length) > remaining)
+        return -1;
+    for (auto i = 1; i < length; ++i)
+        if ((static_cast<unsigned char>(str[i]) & 0xC0) != 0x80)
+            return -1;
+
+    auto cont = [&](int i) { return static_cast<unsigned char>(str[i]) & 0x3F; };
+    switch (length)
+    {
+    case 1:
+        c = byte;
+        break;
+    case 2:
+        c = ((byte & 0x1F) << 6) + cont(1);
+        if (c < 0x80)
+            return -1;
+        break;
+    case 3:
+        c = ((byte & 0x0F) << 12) + (cont(1) << 6) + cont(2);
+        if (c < 0x800 || (c >= 0xD800 && c < 0xE000))
+            return -1;
+        break;
+    case 4:
+        c = ((byte & 0x07) << 18) + (cont(1) << 12) + (cont(2) << 6) + cont(3);
+        if (c < 0x10000 || c >= 0x110000)
+            return -1;
+        break;
+    }
+
+    return length;
+}
+
+int longest_backtick_sequence(const std::string& code) noexcept
+{
+    auto longest = 0, current = 0;
+    for (auto c : code)
+        if (c == '`')
+            ++current;
+        else
+        {
+            if (current > longest)
+                longest = current;
+            current = 0;
+        }
+    return current > longest ? current : longest;
+}
+
+int shortest_unused_backtick_sequence(const std::string& code) noexcept
+{
+    // note: sequences of 32 or more are not tracked, as in cmark
+    std::uint32_t used    = 1u;
+    auto          current = 0;
+    for (auto iter = code.c_str();; ++iter)
+        if (*iter == '`')
+            ++current;
+        else
+        {
+            if (current > 0 && current < 32)
+                used |= 1u << current;
+            current = 0;
+
+            if (*iter == '\0')
+                break;
+        }
+
+    auto result = 0;
+    while (result < 32 && (used & 1u))
+    {
+        used >>= 1;
+        ++result;
+    }
+    return result;
+}
+
+const char* strip_mailto(const std::string& url) noexcept
+{
+    return url.compare(0, 7, "mailto:") == 0 ? url.c_str() + 7 : url.c_str();
+}
+} // namespace
+
+bool detail::is_autolink_candidate(const std::string& url, const std::string& title) noexcept
+{
+    if (!title.empty())
+        return false;
+
+    // scheme = [A-Za-z][A-Za-z0-9.+-]{1,31}:
+    if (url.empty() || !is_alpha(url[0]))
+        return false;
+    auto length = 1u;
+    while (length < url.size() && length <= 32u
+           && (is_alpha(url[length]) || is_digit(url[length]) || url[length] == '.'
+               || url[length] == '+' || url[length] == '-'))
+        ++length;
+    return length >= 2u && length <= 32u && length < url.size() && url[length] == ':';
+}
+
+bool detail::is_autolink_text(const std::string& url, const std::string& text) noexcept
+{
+    return text == strip_mailto(url);
+}
+
+commonmark_writer::commonmark_writer(cmark_type root)
+: need_cr_(0), begin_line_(true), begin_content_(true), in_tight_list_item_(false)
+{
+    assert(root == cmark_type::document || root == cmark_type::paragraph);
+    stack_.emplace_back(root);
+}
+
+void commonmark_writer::finish(std::ostream& out)
+{
+    assert(stack_.size() == 1u);
+    update_tight_list_item();
+    render_exit(stack_.back());
+    stack_.pop_back();
+
+    // ensure final newline
+    if (buffer_.empty() || buffer_.back() != '\n')
+        buffer_ += '\n';
+
+    out << buffer_;
+}
+
+bool commonmark_writer::enter(cmark_type type)
+{
+    auto& parent = stack_.back();
+    if (parent.detached || !can_contain(parent.type, type))
+    {
+        stack_.emplace_back(type);
+        stack_.back().detached = true;
+        return false;
+    }
+
+    if (parent.pending_list_end)
+    {
+        parent.pending_list_end = false;
+        if (type == cmark_type::code_block || type == cmark_type::list)
+        {
+            // this ensures that a following indented code block or list will be interpreted
+            // correctly
+            cr();
+            lit("<!-- end list -->");
+            blankline();
+        }
+    }
+
+    frame f(type);
+    f.first = parent.children == 0u;
+    ++parent.children;
+
+    if (type == cmark_type::item)
+    {
+        if (parent.ordered)
+        {
+            // we ensure a width of at least 4 so we get a nice transition from single digits to
+            // double
+            char marker[20];
+            std::snprintf(marker, sizeof(marker), "%u.%s", parent.children,
+                          parent.children < 10u ? "  " : " ");
+            f.literal = marker;
+        }
+        else
+            f.literal = "  - ";
+        f.marker_width = unsigned(f.literal.size());
+    }
+
+    // don't adjust it until the list has started,
+    // otherwise the blank line between a paragraph and a following list is lost
+    auto first_item = type == cmark_type::item && f.first;
+    stack_.push_back(std::move(f));
+    if (!first_item)
+        update_tight_list_item();
+    return true;
+}
+
+void commonmark_writer::update_tight_list_item() noexcept
+{
+    // the innermost block of the current node, the root is always a block
+    auto block = stack_.size() - 1u;
+    while (!is_block(stack_[block].type))
+        --block;
+
+    // an item is never the root, so it has a parent list
+    auto is_tight_item = [&](std::size_t i) {
+        return stack_[i].type == cmark_type::item && stack_[i - 1u].tight;
+    };
+    in_tight_list_item_ = is_tight_item(block) || (block > 0u && is_tight_item(block - 1u));
+}
+
+void commonmark_writer::begin(cmark_type type)
+{
+    assert(type == cmark_type::block_quote || type == cmark_type::item
+           || type == cmark_type::paragraph || type == cmark_type::strong
+           || type == cmark_type::code);
+    if (enter(type) && type != cmark_type::code)
+        // code is rendered once the literal is complete
+        render_enter(stack_.back());
+}
+
+void commonmark_writer::begin_heading(unsigned level)
+{
+    if (enter(cmark_type::heading))
+    {
+        stack_.back().heading_level = level;
+        render_enter(stack_.back());
+    }
+}
+
+void commonmark_writer::begin_list(bool ordered, bool tight)
+{
+    if (enter(cmark_type::list))
+    {
+        stack_.back().ordered = ordered;
+        stack_.back().tight   = tight;
+        render_enter(stack_.back());
+    }
+}
+
+void commonmark_writer::begin_code_block(const std::string& info)
+{
+    if (enter(cmark_type::code_block))
+        // rendered once the literal is complete
+        stack_.back().info = info;
+}
+
+void commonmark_writer::begin_emph(bool sole_nested)
+{
+    if (enter(cmark_type::emph))
+    {
+        // EMPH(EMPH(x)) needs to use *_x_* as **x** is STRONG(x)
+        stack_.back().sole_nested
+            = sole_nested && stack_[stack_.size() - 2u].type == cmark_type::emph;
+        render_enter(stack_.back());
+    }
+}
+
+bool commonmark_writer::begin_link(const std::string& url, const std::string& title,
+                                   bool autolink)
+{
+    if (!enter(cmark_type::link))
+        return false;
+
+    auto& f    = stack_.back();
+    f.url      = url;
+    f.title    = title;
+    f.autolink = autolink;
+    render_enter(f);
+    return !autolink;
+}
+
+void commonmark_writer::end()
+{
+    assert(stack_.size() > 1u);
+    if (!stack_.back().detached)
+        update_tight_list_item();
+
+    auto f = std::move(stack_.back());
+    stack_.pop_back();
+    if (f.detached)
+        return;
+
+    if (f.type == cmark_type::code_block)
+        render_code_block(f);
+    else if (f.type == cmark_type::code)
+        render_code(f);
+    else
+    {
+        if (f.type == cmark_type::list)
+            // need to know the next sibling
+            stack_.back().pending_list_end = true;
+
+        render_exit(f);
+    }
+}
+
+void commonmark_writer::leaf(cmark_type type, const std::string& literal)
+{
+    assert(type == cmark_type::text || type == cmark_type::softbreak
+           || type == cmark_type::linebreak || type == cmark_type::html_block
+           || type == cmark_type::html_inline || type == cmark_type::thematic_break);
+    if (enter(type))
+    {
+        stack_.back().literal = literal;
+        render_enter(stack_.back());
+    }
+    stack_.pop_back();
+}
+
+void commonmark_writer::append_literal(const char* str)
+{
+    auto& f = stack_.back();
+    if (!f.detached && (f.type == cmark_type::code_block || f.type == cmark_type::code))
+        f.literal += str;
+}
+
+void commonmark_writer::render_enter(const frame& f)
+{
+    switch (f.type)
+    {
+    case cmark_type::document:
+    case cmark_type::list:
+    case cmark_type::paragraph:
+        break;
+
+    case cmark_type::block_quote:
+        lit("> ");
+        begin_content_ = true;
+        prefix_ += "> ";
+        break;
+
+    case cmark_type::item:
+        lit(f.literal.c_str());
+        begin_content_ = true;
+        prefix_.append(f.marker_width, ' ');
+        break;
+
+    case cmark_type::heading:
+        lit(std::string(f.heading_level, '#').c_str());
+        lit(" ");
+        begin_content_ = true;
+        break;
+
+    case cmark_type::html_block:
+        blankline();
+        out(f.literal.c_str(), escaping::literal);
+        blankline();
+        break;
+
+    case cmark_type::thematic_break:
+        blankline();
+        lit("-----");
+        blankline();
+        break;
+
+    case cmark_type::text:
+        out(f.literal.c_str(), escaping::normal);
+        break;
+    case cmark_type::softbreak:
+        lit(" ");
+        break;
+    case cmark_type::linebreak:
+        lit("  ");
+        cr();
+        break;
+    case cmark_type::html_inline:
+        out(f.literal.c_str(), escaping::literal);
+        break;
+
+    case cmark_type::emph:
+        lit(f.sole_nested ? "_" : "*");
+        break;
+    case cmark_type::strong:
+        lit("**");
+        break;
+
+    case cmark_type::link:
+        if (f.autolink)
+        {
+            lit("<");
+            lit(strip_mailto(f.url));
+            lit(">");
+        }
+        else
+            lit("[");
+        break;
+
+    case cmark_type::code_block:
+    case cmark_type::code:
+        assert(false);
+        break;
+    }
+}
+
+void commonmark_writer::render_exit(const frame& f)
+{
+    switch (f.type)
+    {
+    case cmark_type::block_quote:
+        prefix_.resize(prefix_.size() - 2u);
+        blankline();
+        break;
+
+    case cmark_type::item:
+        prefix_.resize(prefix_.size() - f.marker_width);
+        cr();
+        break;
+
+    case cmark_type::heading:
+    case cmark_type::paragraph:
+        blankline();
+        break;
+
+    case cmark_type::emph:
+        lit(f.sole_nested ? "_" : "*");
+        break;
+    case cmark_type::strong:
+        lit("**");
+        break;
+
+    case cmark_type::link:
+        if (!f.autolink)
+        {
+            lit("](");
+            out(f.url.c_str(), escaping::url);
+            if (!f.title.empty())
+            {
+                lit(" \"");
+                out(f.title.c_str(), escaping::title);
+                lit("\"");
+            }
+            lit(")");
+        }
+        break;
+
+    case cmark_type::document:
+    case cmark_type::list:
+    case cmark_type::code_block:
+    case cmark_type::html_block:
+    case cmark_type::thematic_break:
+    case cmark_type::text:
+    case cmark_type::softbreak:
+    case cmark_type::linebreak:
+    case cmark_type::code:
+    case cmark_type::html_inline:
+        break;
+    }
+}
+
+void commonmark_writer::render_code_block(const frame& f)
+{
+    auto first_in_list_item = f.first && stack_.back().type == cmark_type::item;
+    if (!first_in_list_item)
+        blankline();
+
+    auto& code = f.literal;
+    // use indented form if no info, and code doesn't begin or end with a blank line,
+    // and code isn't first thing in a list item
+    if (f.info.empty() && code.size() > 2u && !is_space(code.front())
+        && !(is_space(code[code.size() - 1u]) && is_space(code[code.size() - 2u]))
+        && !first_in_list_item)
+    {
+        lit("    ");
+        prefix_ += "    ";
+        out(code.c_str(), escaping::literal);
+        prefix_.resize(prefix_.size() - 4u);
+    }
+    else
+    {
+        auto fence_char = f.info.find('`') == std::string::npos ? '`' : '~';
+        auto fence_size = longest_backtick_sequence(code) + 1;
+        if (fence_size < 3)
+            fence_size = 3;
+        auto fence = std::string(std::size_t(fence_size), fence_char);
+
+        lit(fence.c_str());
+        lit(" ");
+        out(f.info.c_str(), escaping::literal);
+        cr();
+        out(code.c_str(), escaping::literal);
+        cr();
+        lit(fence.c_str());
+    }
+    blankline();
+}
+
+void commonmark_writer::render_code(const frame& f)
+{
+    auto& code         = f.literal;
+    auto  ticks        = std::string(std::size_t(shortest_unused_backtick_sequence(code)), '`');
+    auto  extra_spaces = code.empty() || code.front() == '`' || code.back() == '`';
+
+    lit(ticks.c_str());
+    if (extra_spaces)
+        lit(" ");
+    out(code.c_str(), escaping::literal);
+    if (extra_spaces)
+        lit(" ");
+    lit(ticks.c_str());
+}
+
+void commonmark_writer::out(const char* str, escaping e)
+{
+    if (in_tight_list_item_ && need_cr_ > 1)
+        need_cr_ = 1;
+
+    // only emit the newlines that are not already there
+    auto k = std::ptrdiff_t(buffer_.size()) - 1;
+    while (need_cr_)
+    {
+        if (k < 0 || buffer_[std::size_t(k)] == '\n')
+            --k;
+        else
+        {
+            buffer_ += '\n';
+            if (need_cr_ > 1)
+                buffer_ += prefix_;
+        }
+        begin_line_    = true;
+        begin_content_ = true;
+        --need_cr_;
+    }
+
+    auto length = std::strlen(str);
+    for (std::size_t i = 0u; i < length;)
+    {
+        if (begin_line_)
+            buffer_ += prefix_;
+
+        int  c;
+        auto len = decode_utf8(str + i, length - i, c);
+        if (len == -1)
+            // like cmark, don't render the rest of the string
+            return;
+
+        auto nextc = static_cast<unsigned char>(str[i + std::size_t(len)]);
+        if (e == escaping::literal && c == '\n')
+        {
+            buffer_ += '\n';
+            begin_line_    = true;
+            begin_content_ = true;
+        }
+        else
+        {
+            if (e == escaping::literal)
+                buffer_.append(str + i, std::size_t(len));
+            else
+                outc(c, str + i, len, nextc, e);
+            begin_line_ = false;
+            // we don't set begin_content to false until we've finished parsing a digit,
+            // we need to escape a potential list marker after it
+            begin_content_ = begin_content_ && is_digit(static_cast<char>(c));
+        }
+
+        i += std::size_t(len);
+    }
+}
+
+void commonmark_writer::outc(int c, const char* bytes, int len, unsigned char nextc, escaping e)
+{
+    auto follows_digit = !buffer_.empty() && is_digit(buffer_.back());
+
+    auto needs_escaping = false;
+    if (c < 0x80)
+    {
+        switch (e)
+        {
+        case escaping::literal:
+            break;
+        case escaping::normal:
+            needs_escaping = c == '*' || c == '_' || c == '[' || c == ']' || c == '#' || c == '<'
+                             || c == '>' || c == '\\' || c == '`' || c == '~' || c == '!'
+                             || (c == '&' && is_alpha(char(nextc)))
+                             || (begin_content_ && (c == '-' || c == '+' || c == '=')
+                                 && !follows_digit)
+                             || (begin_content_ && (c == '.' || c == ')') && follows_digit
+                                 && (nextc == 0 || is_space(char(nextc))));
+            break;
+        case escaping::url:
+            needs_escaping = c == '`' || c == '<' || c == '>' || is_space(char(c)) || c == '\\'
+                             || c == ')' || c == '(';
+            break;
+        case escaping::title:
+            needs_escaping = c == '`' || c == '<' || c == '>' || c == '"' || c == '\\';
+            break;
+        }
+    }
+
+    if (!needs_escaping)
+        buffer_.append(bytes, std::size_t(len));
+    else if (e == escaping::url && is_space(char(c)))
+    {
+        // use percent encoding for spaces
+        char encoded[20];
+        std::snprintf(encoded, sizeof(encoded), "%%%2X", unsigned(c));
+        buffer_ += encoded;
+    }
+    else if (is_punct(c))
+    {
+        buffer_ += '\\';
+        buffer_ += char(c);
+    }
+    else
+    {
+        // render as entity
+        char encoded[20];
+        std::snprintf(encoded, sizeof(encoded), "&#%d;", c);
+        buffer_ += encoded;
+    }
+}
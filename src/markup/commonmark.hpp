@@ -0,0 +1,195 @@
+// Copyright (C) 2016-2019 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef STANDARDESE_MARKUP_COMMONMARK_HPP_INCLUDED
+#define STANDARDESE_MARKUP_COMMONMARK_HPP_INCLUDED
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace standardese
+{
+namespace markup
+{
+    namespace detail
+    {
+        // the cmark node types the markdown generator produces
+        enum class cmark_type
+        {
+            document,
+            block_quote,
+            list,
+            item,
+            code_block,
+            html_block,
+            paragraph,
+            heading,
+            thematic_break,
+
+            text,
+            softbreak,
+            linebreak,
+            code,
+            html_inline,
+            emph,
+            strong,
+            link,
+        };
+
+        // receives the CommonMark AST of an entity as a sequence of events
+        //
+        // A node that cannot be a child of the current node is ignored together with all of its
+        // children, just like `cmark_node_append_child()` would.
+        class cmark_sink
+        {
+        public:
+            virtual ~cmark_sink() noexcept = default;
+
+            // the type of the innermost open node
+            virtual cmark_type current() const noexcept = 0;
+
+            // opens a block quote, item, paragraph, strong or code node
+            virtual void begin(cmark_type type) = 0;
+
+            virtual void begin_heading(unsigned level) = 0;
+
+            // ordered lists always start at 1
+            virtual void begin_list(bool ordered, bool tight) = 0;
+
+            virtual void begin_code_block(const std::string& info) = 0;
+
+            // `sole_nested` must be true if it is the only child of an emphasis
+            virtual void begin_emph(bool sole_nested) = 0;
+
+            // `autolink` must be true if the link text is the URL itself
+            // returns whether or not the link text needs to be written
+            virtual bool begin_link(const std::string& url, const std::string& title,
+                                    bool autolink) = 0;
+
+            // closes the innermost open node
+            virtual void end() = 0;
+
+            // adds a text, softbreak, linebreak, html_block, html_inline or thematic_break node
+            virtual void leaf(cmark_type type, const std::string& literal) = 0;
+
+            // appends to the literal of the current code or code block node
+            virtual void append_literal(const char* str) = 0;
+        };
+
+        // whether or not cmark would render a link with that URL and title as autolink,
+        // provided its text is the URL
+        //
+        // For those links cmark merges the leading text nodes of the link.
+        bool is_autolink_candidate(const std::string& url, const std::string& title) noexcept;
+
+        // whether or not the given link text makes it an autolink
+        bool is_autolink_text(const std::string& url, const std::string& text) noexcept;
+
+        // renders the events directly as CommonMark
+        //
+        // The output is identical to `cmark_render_commonmark()` with `CMARK_OPT_NOBREAKS`,
+        // but no node tree is allocated.
+        class commonmark_writer final : public cmark_sink
+        {
+        public:
+            // root must be document or paragraph
+            explicit commonmark_writer(cmark_type root);
+
+            // closes the root and writes the output
+            void finish(std::ostream& out);
+
+            cmark_type current() const noexcept override
+            {
+                return stack_.back().type;
+            }
+
+            void begin(cmark_type type) override;
+
+            void begin_heading(unsigned level) override;
+
+            void begin_list(bool ordered, bool tight) override;
+
+            void begin_code_block(const std::string& info) override;
+
+            void begin_emph(bool sole_nested) override;
+
+            bool begin_link(const std::string& url, const std::string& title,
+                            bool autolink) override;
+
+            void end() override;
+
+            void leaf(cmark_type type, const std::string& literal) override;
+
+            void append_literal(const char* str) override;
+
+        private:
+            enum class escaping
+            {
+                literal,
+                normal,
+                url,
+                title,
+            };
+
+            struct frame
+            {
+                cmark_type  type;
+                bool        detached         = false;
+                bool        first            = false; // no previous sibling
+                bool        pending_list_end = false; // last attached child was a list
+                unsigned    children         = 0u;    // attached children so far
+                unsigned    heading_level    = 0u;
+                bool        ordered = false, tight = false;
+                unsigned    marker_width = 0u;
+                bool        sole_nested = false, autolink = false;
+                std::string literal, info, url, title;
+
+                explicit frame(cmark_type t) : type(t) {}
+            };
+
+            // pushes a new frame and does the bookkeeping of entering it
+            // returns false if it cannot be attached
+            bool enter(cmark_type type);
+
+            // recomputes whether the current node is inside of a tight list item, like cmark does
+            // for every node it enters or exits
+            void update_tight_list_item() noexcept;
+
+            void render_enter(const frame& f);
+            void render_exit(const frame& f);
+            void render_code_block(const frame& f);
+            void render_code(const frame& f);
+
+            void out(const char* str, escaping e);
+
+            void lit(const char* str)
+            {
+                out(str, escaping::literal);
+            }
+
+            void cr() noexcept
+            {
+                if (need_cr_ < 1)
+                    need_cr_ = 1;
+            }
+
+            void blankline() noexcept
+            {
+                if (need_cr_ < 2)
+                    need_cr_ = 2;
+            }
+
+            void outc(int c, const char* bytes, int len, unsigned char nextc, escaping e);
+
+            std::vector<frame> stack_;
+            std::string        buffer_, prefix_;
+            int                need_cr_;
+            bool               begin_line_, begin_content_, in_tight_list_item_;
+        };
+    } // namespace detail
+} // namespace markup
+} // namespace standardese
+
+#endif // STANDARDESE_MARKUP_COMMONMARK_HPP_INCLUDED
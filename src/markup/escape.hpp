@@ -15,60 +15,77 @@ namespace markup
 {
     namespace detail
     {
+        // writes the string, escaping the special characters
+        //
+        // The characters between special ones are written in bulk,
+        // so the stream isn't called for every character.
+        template <typename IsSpecial, typename Escape>
+        void write_escaped(std::ostream& out, const char* str, IsSpecial is_special,
+                           Escape escape)
+        {
+            auto run = str;
+            auto ptr = str;
+            for (; *ptr; ++ptr)
+                if (is_special(*ptr))
+                {
+                    out.write(run, ptr - run);
+                    escape(*ptr);
+                    run = ptr + 1;
+                }
+            out.write(run, ptr - run);
+        }
+
         inline void write_html_text(std::ostream& out, const char* str)
         {
             // implements rule 1 here:
             // https://www.owasp.org/index.php/XSS_(Cross_Site_Scripting)_Prevention_Cheat_Sheet
-            for (auto ptr = str; *ptr; ++ptr)
-            {
-                auto c = *ptr;
-                if (c == '&')
-                    out << "&amp;";
-                else if (c == '<')
-                    out << "&lt;";
-                else if (c == '>')
-                    out << "&gt;";
-                else if (c == '"')
-                    out << "&quot;";
-                else if (c == '\'')
-                    out << "&#x27;";
-                else if (c == '/')
-                    out << "&#x2F;";
-                else
-                    out << c;
-            }
+            write_escaped(out, str,
+                          [](char c) {
+                              return c == '&' || c == '<' || c == '>' || c == '"' || c == '\''
+                                     || c == '/';
+                          },
+                          [&](char c) {
+                              if (c == '&')
+                                  out << "&amp;";
+                              else if (c == '<')
+                                  out << "&lt;";
+                              else if (c == '>')
+                                  out << "&gt;";
+                              else if (c == '"')
+                                  out << "&quot;";
+                              else if (c == '\'')
+                                  out << "&#x27;";
+                              else
+                                  out << "&#x2F;";
+                          });
         }
 
         inline bool needs_url_escaping(char c)
         {
             // don't escape reserved URL characters
             // don't escape safe URL characters
-            char safe[] = "-_.+!*(),%#@?=;:/,+$"
-                          "0123456789"
-                          "abcdefghijklmnopqrstuvwxyz"
-                          "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-            return std::strchr(safe, c) == nullptr;
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                return false;
+            return std::strchr("-_.+!*(),%#@?=;:/$", c) == nullptr;
         }
 
         inline void write_html_url(std::ostream& out, const char* url)
         {
-            for (auto ptr = url; *ptr; ++ptr)
-            {
-                auto c = *ptr;
-                if (c == '&')
-                    out << "&amp;";
-                else if (c == '\'')
-                    out << "&#x27";
-                else if (needs_url_escaping(c))
-                {
-                    char buf[3];
-                    std::snprintf(buf, 3, "%02X", unsigned(c));
-                    out << "%";
-                    out << buf;
-                }
-                else
-                    out << c;
-            }
+            write_escaped(out, url,
+                          [](char c) { return c == '&' || c == '\'' || needs_url_escaping(c); },
+                          [&](char c) {
+                              if (c == '&')
+                                  out << "&amp;";
+                              else if (c == '\'')
+                                  out << "&#x27";
+                              else
+                              {
+                                  char buf[3];
+                                  std::snprintf(buf, 3, "%02X", unsigned(c));
+                                  out << "%";
+                                  out << buf;
+                              }
+                          });
         }
     } // namespace detail
 } // namespace markup
@@ -499,6 +499,50 @@ void write(html_stream& s, const block_quote& quote)
     write_children(bq, quote);
 }
 
+void write_code_span(html_stream& s, const char* classes, const char* str)
+{
+    s.write_html(R"(<span class=")");
+    s.write_html(classes);
+    s.write_html(R"(">)");
+    s.write(str);
+    s.write_html("</span>");
+}
+
+void write(html_stream& s, const code_block::token& token)
+{
+    switch (token.kind())
+    {
+    case code_block::token_kind::text:
+    case code_block::token_kind::soft_break:
+        s.write(token.c_str());
+        break;
+
+    case code_block::token_kind::keyword:
+        write_code_span(s, "kwd", token.c_str());
+        break;
+    case code_block::token_kind::identifier:
+        write_code_span(s, "typ dec var fun", token.c_str());
+        break;
+    case code_block::token_kind::string_literal:
+        write_code_span(s, "str", token.c_str());
+        break;
+    case code_block::token_kind::int_literal:
+    case code_block::token_kind::float_literal:
+        write_code_span(s, "lit", token.c_str());
+        break;
+    case code_block::token_kind::punctuation:
+        write_code_span(s, "pun", token.c_str());
+        break;
+    case code_block::token_kind::preprocessor:
+        write_code_span(s, "pre", token.c_str());
+        break;
+
+    case code_block::token_kind::entity:
+        write_entity(s, token.entity());
+        break;
+    }
+}
+
 void write(html_stream& s, const code_block& cb, bool is_synopsis)
 {
     std::string classes;
@@ -509,56 +553,42 @@ void write(html_stream& s, const code_block& cb, bool is_synopsis)
 
     auto pre  = s.open_tag(false, true, "pre", block_id());
     auto code = pre.open_tag(false, false, "code", cb.id(), classes.c_str());
-    write_children(code, cb);
+    cb.for_each_token([&](const code_block::token& token) { write(code, token); });
 }
 
 void write(html_stream& s, const code_block::keyword& text)
 {
-    s.write_html(R"(<span class="kwd">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "kwd", text.string().c_str());
 }
 
 void write(html_stream& s, const code_block::identifier& text)
 {
-    s.write_html(R"(<span class="typ dec var fun">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "typ dec var fun", text.string().c_str());
 }
 
 void write(html_stream& s, const code_block::string_literal& text)
 {
-    s.write_html(R"(<span class="str">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "str", text.string().c_str());
 }
 
 void write(html_stream& s, const code_block::int_literal& text)
 {
-    s.write_html(R"(<span class="lit">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "lit", text.string().c_str());
 }
 
 void write(html_stream& s, const code_block::float_literal& text)
 {
-    s.write_html(R"(<span class="lit">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "lit", text.string().c_str());
 }
 
 void write(html_stream& s, const code_block::punctuation& text)
 {
-    s.write_html(R"(<span class="pun">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "pun", text.string().c_str());
 }
 
 void write(html_stream& s, const code_block::preprocessor& text)
 {
-    s.write_html(R"(<span class="pre">)");
-    s.write(text.string());
-    s.write_html("</span>");
+    write_code_span(s, "pre", text.string().c_str());
 }
 
 void write(html_stream& s, const thematic_break&)
@@ -6,8 +6,12 @@
 
 #include <cassert>
 #include <cmark-gfm.h>
+#include <cstdlib>
+#include <iterator>
 #include <ostream>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <standardese/markup/block.hpp>
 #include <standardese/markup/code_block.hpp>
@@ -25,6 +29,7 @@
 #include <standardese/markup/quote.hpp>
 #include <standardese/markup/thematic_break.hpp>
 
+#include "commonmark.hpp"
 #include "escape.hpp"
 
 using namespace standardese::markup;
@@ -37,66 +42,213 @@ struct options
     bool        use_html;
 };
 
-void build_entity(cmark_node* parent, const options& opt, const entity& e);
+using detail::cmark_sink;
+using detail::cmark_type;
 
-template <typename T>
-void handle_children(cmark_node* node, const options& opt, const T& container)
+// builds the cmark node tree, required for the other cmark renderers
+class cmark_tree final : public cmark_sink
 {
-    for (auto& child : container)
-        build_entity(node, opt, child);
-}
+public:
+    explicit cmark_tree(cmark_type root)
+    : root_(cmark_node_new(root == cmark_type::paragraph ? CMARK_NODE_PARAGRAPH
+                                                         : CMARK_NODE_DOCUMENT))
+    {
+        stack_.emplace_back(root_, root);
+    }
 
-cmark_node* build_emph(const char* str)
-{
-    auto emph = cmark_node_new(CMARK_NODE_EMPH);
-    auto text = cmark_node_new(CMARK_NODE_TEXT);
-    cmark_node_set_literal(text, str);
-    cmark_node_append_child(emph, text);
-    return emph;
-}
+    cmark_tree(const cmark_tree&) = delete;
+    cmark_tree& operator=(const cmark_tree&) = delete;
 
-cmark_node* build_heading(unsigned level, const char* str)
-{
-    auto heading = cmark_node_new(CMARK_NODE_HEADING);
-    cmark_node_set_heading_level(heading, int(level));
+    ~cmark_tree() noexcept override
+    {
+        cmark_node_free(root_);
+    }
+
+    cmark_node* root() const noexcept
+    {
+        return root_;
+    }
+
+    cmark_type current() const noexcept override
+    {
+        return stack_.back().second;
+    }
+
+    void begin(cmark_type type) override
+    {
+        switch (type)
+        {
+        case cmark_type::block_quote:
+            push(cmark_node_new(CMARK_NODE_BLOCK_QUOTE), type);
+            break;
+        case cmark_type::item:
+            push(cmark_node_new(CMARK_NODE_ITEM), type);
+            break;
+        case cmark_type::paragraph:
+            push(cmark_node_new(CMARK_NODE_PARAGRAPH), type);
+            break;
+        case cmark_type::strong:
+            push(cmark_node_new(CMARK_NODE_STRONG), type);
+            break;
+        case cmark_type::code:
+            push(cmark_node_new(CMARK_NODE_CODE), type);
+            break;
+        default:
+            assert(false);
+            break;
+        }
+    }
+
+    void begin_heading(unsigned level) override
+    {
+        auto heading = cmark_node_new(CMARK_NODE_HEADING);
+        cmark_node_set_heading_level(heading, int(level));
+        push(heading, cmark_type::heading);
+    }
+
+    void begin_list(bool ordered, bool tight) override
+    {
+        auto list = cmark_node_new(CMARK_NODE_LIST);
+        if (ordered)
+        {
+            cmark_node_set_list_type(list, CMARK_ORDERED_LIST);
+            cmark_node_set_list_start(list, 1);
+        }
+        else
+            cmark_node_set_list_type(list, CMARK_BULLET_LIST);
+        if (tight)
+            cmark_node_set_list_tight(list, 1);
+        push(list, cmark_type::list);
+    }
+
+    void begin_code_block(const std::string& info) override
+    {
+        auto node = cmark_node_new(CMARK_NODE_CODE_BLOCK);
+        if (!info.empty())
+            cmark_node_set_fence_info(node, info.c_str());
+        push(node, cmark_type::code_block);
+    }
+
+    void begin_emph(bool) override
+    {
+        push(cmark_node_new(CMARK_NODE_EMPH), cmark_type::emph);
+    }
+
+    bool begin_link(const std::string& url, const std::string& title, bool) override
+    {
+        auto node = cmark_node_new(CMARK_NODE_LINK);
+        if (!title.empty())
+            cmark_node_set_title(node, title.c_str());
+        cmark_node_set_url(node, url.c_str());
+        push(node, cmark_type::link);
+        return true;
+    }
+
+    void end() override
+    {
+        assert(stack_.size() > 1u);
+        auto node = stack_.back().first;
+        stack_.pop_back();
+        if (!cmark_node_parent(node))
+            // couldn't be appended
+            cmark_node_free(node);
+    }
 
-    if (str)
+    void leaf(cmark_type type, const std::string& literal) override
     {
-        auto text = cmark_node_new(CMARK_NODE_TEXT);
-        cmark_node_set_literal(text, str);
-        cmark_node_append_child(heading, text);
+        cmark_node* node = nullptr;
+        switch (type)
+        {
+        case cmark_type::text:
+            node = cmark_node_new(CMARK_NODE_TEXT);
+            break;
+        case cmark_type::softbreak:
+            node = cmark_node_new(CMARK_NODE_SOFTBREAK);
+            break;
+        case cmark_type::linebreak:
+            node = cmark_node_new(CMARK_NODE_LINEBREAK);
+            break;
+        case cmark_type::html_block:
+            node = cmark_node_new(CMARK_NODE_HTML_BLOCK);
+            break;
+        case cmark_type::html_inline:
+            node = cmark_node_new(CMARK_NODE_HTML_INLINE);
+            break;
+        case cmark_type::thematic_break:
+            node = cmark_node_new(CMARK_NODE_THEMATIC_BREAK);
+            break;
+        default:
+            assert(false);
+            return;
+        }
+
+        if (!literal.empty())
+            cmark_node_set_literal(node, literal.c_str());
+        if (!cmark_node_append_child(stack_.back().first, node))
+            cmark_node_free(node);
     }
 
-    return heading;
+    void append_literal(const char* text) override
+    {
+        auto node = stack_.back().first;
+        auto str  = cmark_node_get_literal(node);
+        if (str)
+            cmark_node_set_literal(node, (std::string(str) + text).c_str());
+        else
+            cmark_node_set_literal(node, text);
+    }
+
+private:
+    void push(cmark_node* node, cmark_type type)
+    {
+        cmark_node_append_child(stack_.back().first, node);
+        stack_.emplace_back(node, type);
+    }
+
+    cmark_node*                                      root_;
+    std::vector<std::pair<cmark_node*, cmark_type>> stack_;
+};
+
+void build_entity(cmark_sink& s, const options& opt, const entity& e);
+
+template <typename T>
+void handle_children(cmark_sink& s, const options& opt, const T& container)
+{
+    for (auto& child : container)
+        build_entity(s, opt, child);
+}
+
+void build_emph(cmark_sink& s, const std::string& str)
+{
+    s.begin_emph(false);
+    s.leaf(cmark_type::text, str);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const code_block& cb);
+void build(cmark_sink& s, const options& opt, const code_block& cb);
 
-void build_list_item(cmark_node* list, const options& opt, const list_item_base& item);
+void build_list_item(cmark_sink& s, const options& opt, const list_item_base& item);
 
-void build_documentation(cmark_node* parent, const options& opt, const documentation_entity& doc)
+void build_documentation(cmark_sink& s, const options& opt, const documentation_entity& doc)
 {
     if (opt.use_html)
     {
-        auto html = cmark_node_new(CMARK_NODE_HTML_BLOCK);
-
         std::ostringstream stream;
         stream << "<span id=\"standardese-";
         detail::write_html_text(stream, doc.id().as_output_str().c_str());
         stream << "\"></span>\n";
 
-        cmark_node_set_literal(html, stream.str().c_str());
-        cmark_node_append_child(parent, html);
+        s.leaf(cmark_type::html_block, stream.str());
     }
 
     if (doc.synopsis())
-        build(parent, opt, doc.synopsis().value());
+        build(s, opt, doc.synopsis().value());
 
     if (auto brief = doc.brief_section())
     {
-        auto paragraph = cmark_node_new(CMARK_NODE_PARAGRAPH);
-        handle_children(paragraph, opt, brief.value());
-        cmark_node_append_child(parent, paragraph);
+        s.begin(cmark_type::paragraph);
+        handle_children(s, opt, brief.value());
+        s.end();
     }
 
     // write inline sections
@@ -108,24 +260,22 @@ void build_documentation(cmark_node* parent, const options& opt, const documenta
             {
                 auto& sec = static_cast<const inline_section&>(section);
 
-                auto paragraph = cmark_node_new(CMARK_NODE_PARAGRAPH);
-                cmark_node_append_child(parent, paragraph);
+                s.begin(cmark_type::paragraph);
 
                 // add section name
-                auto emph = build_emph((sec.name() + ":").c_str());
-                cmark_node_append_child(paragraph, emph);
-                auto sep = cmark_node_new(CMARK_NODE_TEXT);
-                cmark_node_set_literal(sep, " ");
-                cmark_node_append_child(paragraph, sep);
+                build_emph(s, sec.name() + ":");
+                s.leaf(cmark_type::text, " ");
 
                 // build section content
-                handle_children(paragraph, opt, sec);
+                handle_children(s, opt, sec);
+
+                s.end();
             }
     }
 
     // write details section
     if (auto details = doc.details_section())
-        handle_children(parent, opt, details.value());
+        handle_children(s, opt, details.value());
 
     // write list sections
     for (auto& section : doc.doc_sections())
@@ -136,51 +286,43 @@ void build_documentation(cmark_node* parent, const options& opt, const documenta
             auto& list = static_cast<const list_section&>(section);
 
             // heading
-            auto heading = build_heading(4, list.name().c_str());
-            cmark_node_append_child(parent, heading);
+            s.begin_heading(4);
+            s.leaf(cmark_type::text, list.name());
+            s.end();
 
             // list
-            auto ul = cmark_node_new(CMARK_NODE_LIST);
-            cmark_node_set_list_type(ul, CMARK_BULLET_LIST);
-            cmark_node_set_list_tight(ul, 1);
-            cmark_node_append_child(parent, ul);
-
+            s.begin_list(false, true);
             for (auto& item : list)
-                build_list_item(ul, opt, item);
+                build_list_item(s, opt, item);
+            s.end();
         }
 }
 
-void append_module(cmark_node* heading, const std::string& module)
-{
-    auto text = cmark_node_new(CMARK_NODE_TEXT);
-    cmark_node_set_literal(text, (" [" + module + "]").c_str());
-    cmark_node_append_child(heading, text);
-}
-
-void build_doc_header(cmark_node* parent, const options& opt, const documentation_header& header,
+void build_doc_header(cmark_sink& s, const options& opt, const documentation_header& header,
                       unsigned level)
 {
-    auto heading = build_heading(level, nullptr);
-    cmark_node_append_child(parent, heading);
+    s.begin_heading(level);
 
-    handle_children(heading, opt, header.heading());
+    handle_children(s, opt, header.heading());
 
     if (header.module())
-        append_module(heading, header.module().value());
+        s.leaf(cmark_type::text, " [" + header.module().value() + "]");
+
+    s.end();
 }
 
-void build_doc_header(cmark_node* parent, const options& opt, const documentation_entity& doc,
+void build_doc_header(cmark_sink& s, const options& opt, const documentation_entity& doc,
                       unsigned level)
 {
     if (doc.header())
-        build_doc_header(parent, opt, doc.header().value(), level);
+        build_doc_header(s, opt, doc.header().value(), level);
 }
 
-void build(cmark_node* parent, const options& opt, const file_documentation& doc)
+void build(cmark_sink& s, const options& opt, const file_documentation& doc)
 {
-    build_doc_header(parent, opt, doc, 1);
-    build_documentation(parent, opt, doc);
-    handle_children(parent, opt, doc);
+    build_doc_header(s, opt, doc, 1);
+    build_documentation(s, opt, doc);
+    handle_children(s, opt, doc);
 }
 
 unsigned get_documentation_heading_level(const documentation_entity& doc)
@@ -194,359 +336,360 @@ unsigned get_documentation_heading_level(const documentation_entity& doc)
     return 2;
 }
 
-void build(cmark_node* parent, const options& opt, const entity_documentation& doc)
+void build(cmark_sink& s, const options& opt, const entity_documentation& doc)
 {
-    build_doc_header(parent, opt, doc, get_documentation_heading_level(doc));
-    build_documentation(parent, opt, doc);
-    handle_children(parent, opt, doc);
+    build_doc_header(s, opt, doc, get_documentation_heading_level(doc));
+    build_documentation(s, opt, doc);
+    handle_children(s, opt, doc);
 
     if (doc.header())
-        cmark_node_append_child(parent, cmark_node_new(CMARK_NODE_THEMATIC_BREAK));
+        s.leaf(cmark_type::thematic_break, "");
 }
 
-void build(cmark_node* parent, const options& opt, const entity_index_item& item);
-void build(cmark_node* parent, const options& opt, const namespace_documentation& doc);
-void build(cmark_node* parent, const options& opt, const module_documentation& doc);
+void build(cmark_sink& s, const options& opt, const entity_index_item& item);
+void build(cmark_sink& s, const options& opt, const namespace_documentation& doc);
+void build(cmark_sink& s, const options& opt, const module_documentation& doc);
 
-void build_index_child(cmark_node* parent, const options& opt, const block_entity& child)
+void build_index_child(cmark_sink& s, const options& opt, const block_entity& child)
 {
     if (child.kind() == entity_kind::entity_index_item)
-        build(parent, opt, static_cast<const entity_index_item&>(child));
+        build(s, opt, static_cast<const entity_index_item&>(child));
     else if (child.kind() == entity_kind::namespace_documentation)
-        build(parent, opt, static_cast<const namespace_documentation&>(child));
+        build(s, opt, static_cast<const namespace_documentation&>(child));
     else if (child.kind() == entity_kind::module_documentation)
-        build(parent, opt, static_cast<const module_documentation&>(child));
+        build(s, opt, static_cast<const module_documentation&>(child));
     else
         assert(false);
 }
 
 template <class T>
-void build_module_ns(cmark_node* parent, const options& opt, const T& doc)
+void build_module_ns(cmark_sink& s, const options& opt, const T& doc)
 {
-    auto item = cmark_node_new(CMARK_NODE_ITEM);
-    cmark_node_append_child(parent, item);
-
-    build_doc_header(item, opt, doc, get_documentation_heading_level(doc));
-    build_documentation(item, opt, doc);
+    s.begin(cmark_type::item);
 
-    auto list = cmark_node_new(CMARK_NODE_LIST);
-    cmark_node_set_list_type(list, CMARK_BULLET_LIST);
-    cmark_node_append_child(item, list);
+    build_doc_header(s, opt, doc, get_documentation_heading_level(doc));
+    build_documentation(s, opt, doc);
 
+    s.begin_list(false, false);
     for (auto& child : doc)
-        build_index_child(list, opt, child);
+        build_index_child(s, opt, child);
+    s.end();
+
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const namespace_documentation& doc)
+void build(cmark_sink& s, const options& opt, const namespace_documentation& doc)
 {
-    build_module_ns(parent, opt, doc);
+    build_module_ns(s, opt, doc);
 }
 
-void build(cmark_node* parent, const options& opt, const module_documentation& doc)
+void build(cmark_sink& s, const options& opt, const module_documentation& doc)
 {
-    build_module_ns(parent, opt, doc);
+    build_module_ns(s, opt, doc);
 }
 
-void build_term_description(cmark_node* parent, const options& opt, const term& t,
+void build_term_description(cmark_sink& s, const options& opt, const term& t,
                             const description* desc);
 
-void build(cmark_node* parent, const options& opt, const entity_index_item& item)
+void build(cmark_sink& s, const options& opt, const entity_index_item& item)
 {
-    auto node = cmark_node_new(CMARK_NODE_ITEM);
-    cmark_node_append_child(parent, node);
-    build_term_description(node, opt, item.entity(),
-                           item.brief() ? &item.brief().value() : nullptr);
+    s.begin(cmark_type::item);
+    build_term_description(s, opt, item.entity(), item.brief() ? &item.brief().value() : nullptr);
+    s.end();
 }
 
 template <class Index>
-void build_index(cmark_node* parent, const options& opt, const Index& index)
+void build_index(cmark_sink& s, const options& opt, const Index& index)
 {
-    auto heading = build_heading(1, nullptr);
-    cmark_node_append_child(parent, heading);
-    handle_children(heading, opt, index.heading());
-
-    auto list = cmark_node_new(CMARK_NODE_LIST);
-    cmark_node_set_list_type(list, CMARK_BULLET_LIST);
-    cmark_node_append_child(parent, list);
+    s.begin_heading(1);
+    handle_children(s, opt, index.heading());
+    s.end();
 
+    s.begin_list(false, false);
     for (auto& child : index)
-        build_index_child(list, opt, child);
+        build_index_child(s, opt, child);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const file_index& index)
+void build(cmark_sink& s, const options& opt, const file_index& index)
 {
-    build_index(parent, opt, index);
+    build_index(s, opt, index);
 }
 
-void build(cmark_node* parent, const options& opt, const entity_index& index)
+void build(cmark_sink& s, const options& opt, const entity_index& index)
 {
-    build_index(parent, opt, index);
+    build_index(s, opt, index);
 }
 
-void build(cmark_node* parent, const options& opt, const module_index& index)
+void build(cmark_sink& s, const options& opt, const module_index& index)
 {
-    build_index(parent, opt, index);
+    build_index(s, opt, index);
 }
 
-void build(cmark_node* parent, const options& opt, const heading& h)
+void build(cmark_sink& s, const options& opt, const heading& h)
 {
-    auto heading = build_heading(4, nullptr);
-    cmark_node_append_child(parent, heading);
-    handle_children(heading, opt, h);
+    s.begin_heading(4);
+    handle_children(s, opt, h);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const subheading& h)
+void build(cmark_sink& s, const options& opt, const subheading& h)
 {
-    auto heading = build_heading(5, nullptr);
-    cmark_node_append_child(parent, heading);
-    handle_children(heading, opt, h);
+    s.begin_heading(5);
+    handle_children(s, opt, h);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const paragraph& par)
+void build(cmark_sink& s, const options& opt, const paragraph& par)
 {
-    auto node = cmark_node_new(CMARK_NODE_PARAGRAPH);
-    cmark_node_append_child(parent, node);
-    handle_children(node, opt, par);
+    s.begin(cmark_type::paragraph);
+    handle_children(s, opt, par);
+    s.end();
 }
 
-void build_term_description(cmark_node* parent, const options& opt, const term& t,
+void build_term_description(cmark_sink& s, const options& opt, const term& t,
                             const description* desc)
 {
-    auto paragraph = cmark_node_new(CMARK_NODE_PARAGRAPH);
-    cmark_node_append_child(parent, paragraph);
+    s.begin(cmark_type::paragraph);
 
-    handle_children(paragraph, opt, t);
+    handle_children(s, opt, t);
 
     if (desc)
     {
         if (opt.use_html)
-        {
-            auto html = cmark_node_new(CMARK_NODE_HTML_INLINE);
-            cmark_node_set_literal(html, " &mdash; ");
-            cmark_node_append_child(paragraph, html);
-        }
+            s.leaf(cmark_type::html_inline, " &mdash; ");
         else
-        {
-            auto text = cmark_node_new(CMARK_NODE_TEXT);
-            cmark_node_set_literal(text, " - ");
-            cmark_node_append_child(paragraph, text);
-        }
+            s.leaf(cmark_type::text, " - ");
 
-        handle_children(paragraph, opt, *desc);
+        handle_children(s, opt, *desc);
     }
+
+    s.end();
 }
 
-void build_list_item(cmark_node* parent, const options& opt, const list_item_base& item)
+void build_list_item(cmark_sink& s, const options& opt, const list_item_base& item)
 {
-    auto li = cmark_node_new(CMARK_NODE_ITEM);
-    cmark_node_append_child(parent, li);
+    s.begin(cmark_type::item);
 
     if (item.kind() == entity_kind::list_item)
-        handle_children(li, opt, static_cast<const list_item&>(item));
+        handle_children(s, opt, static_cast<const list_item&>(item));
     else if (item.kind() == entity_kind::term_description_item)
     {
         auto& term        = static_cast<const term_description_item&>(item).term();
         auto& description = static_cast<const term_description_item&>(item).description();
-        build_term_description(li, opt, term, &description);
+        build_term_description(s, opt, term, &description);
     }
     else
         assert(false);
+
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const unordered_list& list)
+void build(cmark_sink& s, const options& opt, const unordered_list& list)
 {
-    auto ul = cmark_node_new(CMARK_NODE_LIST);
-    cmark_node_set_list_type(ul, CMARK_BULLET_LIST);
-    cmark_node_append_child(parent, ul);
-
+    s.begin_list(false, false);
     for (auto& item : list)
-        build_list_item(ul, opt, item);
+        build_list_item(s, opt, item);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const ordered_list& list)
+void build(cmark_sink& s, const options& opt, const ordered_list& list)
 {
-    auto ul = cmark_node_new(CMARK_NODE_LIST);
-    cmark_node_set_list_type(ul, CMARK_ORDERED_LIST);
-    cmark_node_set_list_start(ul, 1);
-    cmark_node_append_child(parent, ul);
-
+    s.begin_list(true, false);
     for (auto& item : list)
-        build_list_item(ul, opt, item);
+        build_list_item(s, opt, item);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const block_quote& quote)
+void build(cmark_sink& s, const options& opt, const block_quote& quote)
 {
-    auto node = cmark_node_new(CMARK_NODE_BLOCK_QUOTE);
-    cmark_node_append_child(parent, node);
-
-    handle_children(node, opt, quote);
+    s.begin(cmark_type::block_quote);
+    handle_children(s, opt, quote);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const code_block& cb)
+void build(cmark_sink& s, const options& opt, const code_block& cb)
 {
     if (opt.use_html)
-    {
-        auto node = cmark_node_new(CMARK_NODE_HTML_BLOCK);
-        cmark_node_append_child(parent, node);
-
-        auto html = render(html_generator(opt.prefix, opt.extension), cb);
-        cmark_node_set_literal(node, html.c_str());
-    }
+        s.leaf(cmark_type::html_block, render(html_generator(opt.prefix, opt.extension), cb));
     else
     {
-        auto node = cmark_node_new(CMARK_NODE_CODE_BLOCK);
-        cmark_node_append_child(parent, node);
-
-        if (!cb.language().empty())
-            cmark_node_set_fence_info(node, cb.language().c_str());
-
-        handle_children(node, opt, cb);
+        s.begin_code_block(cb.language());
+        cb.for_each_token([&](const code_block::token& token) {
+            if (token.kind() == code_block::token_kind::entity)
+                build_entity(s, opt, token.entity());
+            else
+                // the syntax highlighting is lost anyway
+                s.append_literal(token.c_str());
+        });
+        s.end();
     }
 }
 
-void append_code_block_text(cmark_node* cb, const std::string& text)
+void build(cmark_sink& s, const options&, const code_block::keyword& text)
 {
-    auto str = cmark_node_get_literal(cb);
-    if (str)
-        cmark_node_set_literal(cb, (str + text).c_str());
-    else
-        cmark_node_set_literal(cb, text.c_str());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::keyword& text)
+void build(cmark_sink& s, const options&, const code_block::identifier& text)
 {
-    append_code_block_text(parent, text.string());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::identifier& text)
+void build(cmark_sink& s, const options&, const code_block::string_literal& text)
 {
-    append_code_block_text(parent, text.string());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::string_literal& text)
+void build(cmark_sink& s, const options&, const code_block::int_literal& text)
 {
-    append_code_block_text(parent, text.string());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::int_literal& text)
+void build(cmark_sink& s, const options&, const code_block::float_literal& text)
 {
-    append_code_block_text(parent, text.string());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::float_literal& text)
+void build(cmark_sink& s, const options&, const code_block::punctuation& text)
 {
-    append_code_block_text(parent, text.string());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::punctuation& text)
+void build(cmark_sink& s, const options&, const code_block::preprocessor& text)
 {
-    append_code_block_text(parent, text.string());
+    s.append_literal(text.string().c_str());
 }
 
-void build(cmark_node* parent, const options&, const code_block::preprocessor& text)
+void build(cmark_sink& s, const options&, const thematic_break&)
 {
-    append_code_block_text(parent, text.string());
+    s.leaf(cmark_type::thematic_break, "");
 }
 
-void build(cmark_node* parent, const options&, const thematic_break&)
+void build(cmark_sink& s, const options&, const text& t)
 {
-    auto node = cmark_node_new(CMARK_NODE_THEMATIC_BREAK);
-    cmark_node_append_child(parent, node);
+    if (s.current() == cmark_type::code_block || s.current() == cmark_type::code)
+        s.append_literal(t.string().c_str());
+    else
+        s.leaf(cmark_type::text, t.string());
 }
 
-void build(cmark_node* parent, const options&, const text& t)
+void build_emph(cmark_sink& s, const options& opt, const emphasis& emph, bool sole_nested)
 {
-    if (cmark_node_get_type(parent) == CMARK_NODE_CODE_BLOCK
-        || cmark_node_get_type(parent) == CMARK_NODE_CODE)
-        append_code_block_text(parent, t.string());
+    s.begin_emph(sole_nested);
+
+    auto first = emph.begin();
+    if (first != emph.end() && std::next(first) == emph.end()
+        && first->kind() == entity_kind::emphasis)
+        build_emph(s, opt, static_cast<const emphasis&>(*first), true);
     else
-    {
-        auto text = cmark_node_new(CMARK_NODE_TEXT);
-        cmark_node_append_child(parent, text);
-        cmark_node_set_literal(text, t.string().c_str());
-    }
+        handle_children(s, opt, emph);
+
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const emphasis& emph)
+void build(cmark_sink& s, const options& opt, const emphasis& emph)
 {
-    auto node = cmark_node_new(CMARK_NODE_EMPH);
-    cmark_node_append_child(parent, node);
-
-    handle_children(node, opt, emph);
+    build_emph(s, opt, emph, false);
 }
 
-void build(cmark_node* parent, const options& opt, const strong_emphasis& emph)
+void build(cmark_sink& s, const options& opt, const strong_emphasis& emph)
 {
-    auto node = cmark_node_new(CMARK_NODE_STRONG);
-    cmark_node_append_child(parent, node);
-
-    handle_children(node, opt, emph);
+    s.begin(cmark_type::strong);
+    handle_children(s, opt, emph);
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const code& c)
+void build(cmark_sink& s, const options& opt, const code& c)
 {
-    auto node = cmark_node_new(CMARK_NODE_CODE);
-    cmark_node_append_child(parent, node);
-    handle_children(node, opt, c);
+    s.begin(cmark_type::code);
+    handle_children(s, opt, c);
+    s.end();
 }
 
-void build(cmark_node* parent, const options&, const verbatim& v)
+void build(cmark_sink& s, const options&, const verbatim& v)
 {
     // build inline HTML and hope it works
-    auto node = cmark_node_new(CMARK_NODE_HTML_INLINE);
-    cmark_node_append_child(parent, node);
-    cmark_node_set_literal(node, v.content().c_str());
+    s.leaf(cmark_type::html_inline, v.content());
 }
 
-void build(cmark_node* parent, const options&, const soft_break&)
+void build(cmark_sink& s, const options&, const soft_break&)
 {
-    if (cmark_node_get_type(parent) == CMARK_NODE_CODE_BLOCK)
-        append_code_block_text(parent, "\n");
+    if (s.current() == cmark_type::code_block)
+        s.append_literal("\n");
     else
-    {
-        auto node = cmark_node_new(CMARK_NODE_SOFTBREAK);
-        cmark_node_append_child(parent, node);
-    }
+        s.leaf(cmark_type::softbreak, "");
 }
 
-void build(cmark_node* parent, const options&, const hard_break&)
+void build(cmark_sink& s, const options&, const hard_break&)
 {
-    if (cmark_node_get_type(parent) == CMARK_NODE_CODE_BLOCK)
-        append_code_block_text(parent, "\n");
+    if (s.current() == cmark_type::code_block)
+        s.append_literal("\n");
     else
-    {
-        auto node = cmark_node_new(CMARK_NODE_LINEBREAK);
-        cmark_node_append_child(parent, node);
-    }
+        s.leaf(cmark_type::linebreak, "");
 }
 
-cmark_node* build_link(const char* title, const char* url)
+// the literal of the first child node of a link after merging adjacent text nodes
+std::string get_link_literal(const link_base& link)
 {
-    auto node = cmark_node_new(CMARK_NODE_LINK);
-    if (*title != '\0')
-        cmark_node_set_title(node, title);
-    cmark_node_set_url(node, url);
+    std::string result;
+
+    auto cur = link.begin();
+    if (cur == link.end())
+        return result;
+    else if (cur->kind() == entity_kind::text)
+        for (; cur != link.end() && cur->kind() == entity_kind::text; ++cur)
+            result += static_cast<const text&>(*cur).string();
+    else if (cur->kind() == entity_kind::verbatim)
+        result = static_cast<const verbatim&>(*cur).content();
+    else if (cur->kind() == entity_kind::code)
+        for (auto& child : static_cast<const code&>(*cur))
+            if (child.kind() == entity_kind::text)
+                result += static_cast<const text&>(child).string();
 
-    return node;
+    return result;
 }
 
-void build(cmark_node* parent, const options& opt, const external_link& link)
+void build_link(cmark_sink& s, const options& opt, const link_base& link, const std::string& url)
 {
-    if (cmark_node_get_type(parent) == CMARK_NODE_CODE_BLOCK)
-        handle_children(parent, opt, link);
-    else
+    auto cur      = link.begin();
+    auto autolink = false;
+    auto merged   = false;
+    if (cur != link.end() && detail::is_autolink_candidate(url, link.title()))
+    {
+        autolink = detail::is_autolink_text(url, get_link_literal(link));
+        // cmark merges the leading text nodes while checking for an autolink
+        merged = cur->kind() == entity_kind::text;
+    }
+
+    if (s.begin_link(url, link.title(), autolink))
     {
-        auto node = build_link(link.title().c_str(), link.url().as_str().c_str());
-        cmark_node_append_child(parent, node);
+        if (merged)
+        {
+            std::string str;
+            for (; cur != link.end() && cur->kind() == entity_kind::text; ++cur)
+                str += static_cast<const text&>(*cur).string();
+            s.leaf(cmark_type::text, str);
+        }
 
-        handle_children(node, opt, link);
+        for (; cur != link.end(); ++cur)
+            build_entity(s, opt, *cur);
     }
+    s.end();
 }
 
-void build(cmark_node* parent, const options& opt, const documentation_link& link)
+void build(cmark_sink& s, const options& opt, const external_link& link)
 {
-    if (cmark_node_get_type(parent) == CMARK_NODE_CODE_BLOCK)
-        handle_children(parent, opt, link);
+    if (s.current() == cmark_type::code_block)
+        handle_children(s, opt, link);
+    else
+        build_link(s, opt, link, link.url().as_str());
+}
+
+void build(cmark_sink& s, const options& opt, const documentation_link& link)
+{
+    if (s.current() == cmark_type::code_block)
+        handle_children(s, opt, link);
     else if (link.internal_destination())
     {
         auto url = opt.prefix
@@ -557,36 +700,26 @@ void build(cmark_node* parent, const options& opt, const documentation_link& lin
                          .value_or("");
         url += "#standardese-" + link.internal_destination().value().id().as_output_str();
 
-        auto node = build_link(link.title().c_str(), url.c_str());
-        cmark_node_append_child(parent, node);
-
-        handle_children(node, opt, link);
+        build_link(s, opt, link, url);
     }
     else if (link.external_destination())
-    {
-        auto url = link.external_destination().value().as_str();
-
-        auto node = build_link(link.title().c_str(), url.c_str());
-        cmark_node_append_child(parent, node);
-
-        handle_children(node, opt, link);
-    }
+        build_link(s, opt, link, link.external_destination().value().as_str());
     else
         // only write link content
-        handle_children(parent, opt, link);
+        handle_children(s, opt, link);
 }
 
-void build_entity(cmark_node* parent, const options& opt, const entity& e)
+void build_entity(cmark_sink& s, const options& opt, const entity& e)
 {
     switch (e.kind())
     {
 #define STANDARDESE_DETAIL_HANDLE(Kind)                                                            \
     case entity_kind::Kind:                                                                        \
-        build(parent, opt, static_cast<const Kind&>(e));                                           \
+        build(s, opt, static_cast<const Kind&>(e));                                                \
         break;
 #define STANDARDESE_DETAIL_HANDLE_CODE_BLOCK(Kind)                                                 \
     case entity_kind::code_block_##Kind:                                                           \
-        build(parent, opt, static_cast<const code_block::Kind&>(e));                               \
+        build(s, opt, static_cast<const code_block::Kind&>(e));                                    \
         break;
 
         STANDARDESE_DETAIL_HANDLE(file_documentation)
@@ -650,18 +783,18 @@ void build_entity(cmark_node* parent, const options& opt, const entity& e)
     }
 }
 
-cmark_node* build_entity(const options& opt, const entity& e)
+void build_root(cmark_sink& s, const options& opt, const entity& e)
 {
-    auto doc = is_phrasing(e.kind()) ? cmark_node_new(CMARK_NODE_PARAGRAPH)
-                                     : cmark_node_new(CMARK_NODE_DOCUMENT);
-
     if (e.kind() == entity_kind::main_document || e.kind() == entity_kind::subdocument
         || e.kind() == entity_kind::template_document)
-        handle_children(doc, opt, static_cast<const document_entity&>(e));
+        handle_children(s, opt, static_cast<const document_entity&>(e));
     else
-        build_entity(doc, opt, e);
+        build_entity(s, opt, e);
+}
 
-    return doc;
+cmark_type get_root_type(const entity& e)
+{
+    return is_phrasing(e.kind()) ? cmark_type::paragraph : cmark_type::document;
 }
 } // namespace
 
@@ -670,13 +803,9 @@ generator standardese::markup::markdown_generator(bool use_html, const std::stri
 {
     options opt{prefix, extension, use_html};
     return [opt](std::ostream& out, const entity& e) {
-        auto doc = build_entity(opt, e);
-
-        auto str = cmark_render_commonmark(doc, CMARK_OPT_NOBREAKS, 0);
-        out << str;
-        std::free(str);
-
-        cmark_node_free(doc);
+        detail::commonmark_writer writer(get_root_type(e));
+        build_root(writer, opt, e);
+        writer.finish(out);
     };
 }
 
@@ -684,12 +813,11 @@ generator standardese::markup::text_generator() noexcept
 {
     options opt{"", "txt", false};
     return [opt](std::ostream& out, const entity& e) {
-        auto doc = build_entity(opt, e);
+        cmark_tree tree(get_root_type(e));
+        build_root(tree, opt, e);
 
-        auto str = cmark_render_plaintext(doc, CMARK_OPT_NOBREAKS, 0);
+        auto str = cmark_render_plaintext(tree.root(), CMARK_OPT_NOBREAKS, 0);
         out << str;
         std::free(str);
-
-        cmark_node_free(doc);
     };
 }
@@ -25,6 +25,8 @@
 #include <standardese/markup/quote.hpp>
 #include <standardese/markup/thematic_break.hpp>
 
+#include "escape.hpp"
+
 using namespace standardese::markup;
 
 namespace
@@ -82,22 +84,23 @@ public:
     // writes XML escaped text
     void write(const char* str)
     {
-        for (auto ptr = str; *ptr; ++ptr)
-        {
-            auto c = *ptr;
-            if (c == '&')
-                *out_ << "&amp;";
-            else if (c == '<')
-                *out_ << "&lt;";
-            else if (c == '>')
-                *out_ << "&gt;";
-            else if (c == '"')
-                *out_ << "&quot;";
-            else if (c == '\'')
-                *out_ << "&apos;";
-            else
-                *out_ << c;
-        }
+        detail::write_escaped(*out_, str,
+                              [](char c) {
+                                  return c == '&' || c == '<' || c == '>' || c == '"'
+                                         || c == '\'';
+                              },
+                              [&](char c) {
+                                  if (c == '&')
+                                      *out_ << "&amp;";
+                                  else if (c == '<')
+                                      *out_ << "&lt;";
+                                  else if (c == '>')
+                                      *out_ << "&gt;";
+                                  else if (c == '"')
+                                      *out_ << "&quot;";
+                                  else
+                                      *out_ << "&apos;";
+                              });
     }
 
     void write(const std::string& str)
@@ -318,19 +321,63 @@ void write(xml_stream& s, const block_quote& quote)
     write_block(s, "block-quote", quote);
 }
 
-void write(xml_stream& s, const code_block& code)
+void write_cb(xml_stream& s, const char* tag_name, const char* str)
 {
-    auto tag = s.open_tag(xml_stream::line_tag, "code-block",
-                          std::make_pair("id", code.id().as_output_str()),
-                          std::make_pair("language", code.language()));
-    write_children(tag, code);
+    auto tag = s.open_tag(xml_stream::inline_tag, tag_name);
+    tag.write(str);
 }
 
 template <typename T>
 void write_cb(xml_stream& s, const char* tag_name, const T& cb)
 {
-    auto tag = s.open_tag(xml_stream::inline_tag, tag_name);
-    tag.write(cb.string());
+    write_cb(s, tag_name, cb.string().c_str());
+}
+
+void write(xml_stream& s, const code_block::token& token)
+{
+    switch (token.kind())
+    {
+    case code_block::token_kind::text:
+        s.write(token.c_str());
+        break;
+    case code_block::token_kind::soft_break:
+        s.open_tag(xml_stream::line_tag, "soft-break");
+        break;
+
+    case code_block::token_kind::keyword:
+        write_cb(s, "code-block-keyword", token.c_str());
+        break;
+    case code_block::token_kind::identifier:
+        write_cb(s, "code-block-identifier", token.c_str());
+        break;
+    case code_block::token_kind::string_literal:
+        write_cb(s, "code-block-string-literal", token.c_str());
+        break;
+    case code_block::token_kind::int_literal:
+        write_cb(s, "code-block-int-literal", token.c_str());
+        break;
+    case code_block::token_kind::float_literal:
+        write_cb(s, "code-block-float-literal", token.c_str());
+        break;
+    case code_block::token_kind::punctuation:
+        write_cb(s, "code-block-punctuation", token.c_str());
+        break;
+    case code_block::token_kind::preprocessor:
+        write_cb(s, "code-block-preprocessor", token.c_str());
+        break;
+
+    case code_block::token_kind::entity:
+        write_entity(s, token.entity());
+        break;
+    }
+}
+
+void write(xml_stream& s, const code_block& code)
+{
+    auto tag = s.open_tag(xml_stream::line_tag, "code-block",
+                          std::make_pair("id", code.id().as_output_str()),
+                          std::make_pair("language", code.language()));
+    code.for_each_token([&](const code_block::token& token) { write(tag, token); });
 }
 
 void write(xml_stream& s, const code_block::keyword& cb)
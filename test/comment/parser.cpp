@@ -9,6 +9,7 @@
 #include "../util/indent.hpp"
 
 #include "../../include/standardese/comment/parser.hpp"
+#include "../../include/standardese/markup/generator.hpp"
 #include "standardese/comment/config.hpp"
 
 namespace standardese::test::comment {
@@ -1110,4 +1111,70 @@ TEST_CASE("Standardese Commands", "[comment]")
     }
 }
 
+TEST_CASE("Sections are Parsed on First Access", "[comment]")
+{
+    SECTION("Comments Without Sections Only Have Metadata")
+    {
+        const auto parsed = parse(R"(\exclude)");
+        REQUIRE(parsed.comment.has_value());
+        CHECK(!parsed.comment.value().has_sections());
+        CHECK(!parsed.comment.value().brief_section());
+        CHECK(parsed.comment.value().sections().empty());
+    }
+    SECTION("Sections are Kept When Merging Metadata")
+    {
+        auto parsed = parse(R"(
+            \unique_name foo
+            The brief.
+            )");
+        REQUIRE(parsed.comment.has_value());
+        CHECK(parsed.comment.value().has_sections());
+
+        const auto merged = standardese::comment::merge(standardese::comment::metadata(),
+                                                        std::move(parsed.comment.value()));
+        CHECK(merged.metadata().unique_name() == "foo");
+        CHECK(merged.has_sections());
+        CHECK_BRIEF_EQUIVALENT_TO(merged, R"(
+            <brief-section>The brief.</brief-section>
+            )");
+    }
+    SECTION("Sections are Parsed Again After Handing Them Over")
+    {
+        const auto parsed = parse(R"(
+            The brief.
+
+            \effects Effects.
+            )");
+        REQUIRE(parsed.comment.has_value());
+
+        auto owned = parsed.comment.value().take_sections();
+        REQUIRE(owned.brief);
+        CHECK(standardese::markup::as_xml(*owned.brief) == unindent(R"(
+            <brief-section>The brief.</brief-section>
+            )"));
+        CHECK(owned.sections.size() == 1u);
+
+        CHECK(parsed.comment.value().has_sections());
+        CHECK_BRIEF_EQUIVALENT_TO(parsed, R"(
+            <brief-section>The brief.</brief-section>
+            )");
+        CHECK(parsed.comment.value().sections().size() == 1u);
+    }
+    SECTION("Sections are Built After the Parser is Reused")
+    {
+        const standardese::comment::parser p;
+        const auto first  = standardese::comment::parse(p, "First.", true);
+        const auto second = standardese::comment::parse(p, "Second.", true);
+        REQUIRE(first.comment.has_value());
+        REQUIRE(second.comment.has_value());
+
+        CHECK_BRIEF_EQUIVALENT_TO(first, R"(
+            <brief-section>First.</brief-section>
+            )");
+        CHECK_BRIEF_EQUIVALENT_TO(second, R"(
+            <brief-section>Second.</brief-section>
+            )");
+    }
+}
+
 }
@@ -116,6 +116,30 @@ file - doc_entity__ignored
   entity - foo
     entity - foo::inline_friend()
   entity - func()
+)");
+    }
+    SECTION("fast preprocessing")
+    {
+        // the macros of included files must still be expanded
+        std::ofstream header("doc_entity__fast_preprocessing.inc");
+        header << "#define DOC_ENTITY__FAST_PREPROCESSING_DECLARE(Name) void Name();\n";
+        header << "struct from_header {};\n";
+        header.close();
+
+        auto file = parse_file({}, "doc_entity__fast_preprocessing", R"(
+#include "doc_entity__fast_preprocessing.inc"
+
+DOC_ENTITY__FAST_PREPROCESSING_DECLARE(foo)
+
+from_header bar();
+)",
+                               true);
+        auto doc  = build_doc_entities(comments, {}, std::move(file));
+
+        REQUIRE(debug_string(*doc) == R"(
+file - doc_entity__fast_preprocessing
+  entity - foo()
+  entity - bar()
 )");
     }
     SECTION("excluded")
@@ -163,6 +187,25 @@ file - doc_entity__excluded.hpp
   entity - foo
 )");
     }
+    SECTION("released file")
+    {
+        auto file = build_doc_entities(comments, {}, "doc_entity__released_file.hpp", R"(
+class base {};
+
+/// \exclude
+class excluded {};
+
+class derived : public base
+{
+   void func(int param);
+};
+)");
+        auto expected = debug_string(*file);
+
+        // it can be built again, as if it was just parsed
+        auto rebuilt = build_doc_entities(comments, {}, file->release_file());
+        REQUIRE(debug_string(*rebuilt) == expected);
+    }
     SECTION("blacklisted")
     {
         entity_blacklist blacklist;
@@ -189,6 +232,19 @@ namespace outer
          struct b {};
     }
 }
+
+namespace other
+{
+    namespace outer
+    {
+        struct c {};
+
+        namespace inner
+        {
+            struct d {};
+        }
+    }
+}
 )",
                                        blacklist);
 
@@ -198,6 +254,9 @@ file - doc_entity__blacklisted.cpp
     entity - inner::b
   namespace - outer
     entity - outer::a
+  namespace - other
+    namespace - other::outer
+      entity - other::outer::c
 )");
     }
 
@@ -6,6 +6,9 @@
 
 #include "../external/catch/single_include/catch2/catch.hpp"
 
+#include <mutex>
+#include <thread>
+
 #include <standardese/index.hpp>
 #include <standardese/linker.hpp>
 #include <standardese/markup/document.hpp>
@@ -348,6 +351,54 @@ void a(int param);
 </file-documentation>
 )*");
     }
+    SECTION("parallel")
+    {
+        auto file = build_doc_entities(comments, index, "documentation__parallel.cpp", R"(
+/// A.
+void a();
+
+/// B.
+struct b {};
+
+namespace ns
+{
+    /// C.
+    void c();
+
+    /// D.
+    /// \param i An int.
+    void d(int i);
+
+    /// E.
+    void e();
+}
+
+/// F.
+void f();
+)");
+
+        auto serial = markup::as_xml(*generate_documentation({}, {}, index, *file));
+
+        // the namespace is generated on one of the threads and forks as well
+        std::mutex               mutex;
+        std::vector<std::thread> threads;
+        generation_config        config;
+        config.set_parallel_threshold(2u);
+        config.set_executor(
+            [&](std::function<void()> task) {
+                std::lock_guard<std::mutex> lock(mutex);
+                threads.emplace_back(std::move(task));
+            },
+            2u);
+
+        auto parallel = markup::as_xml(*generate_documentation(config, {}, index, *file));
+        // the documentation is finished, so no new threads are started
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(!threads.empty());
+        REQUIRE(parallel == serial);
+    }
     SECTION("entity_index")
     {
         file_comment_parser parser(test_logger());
@@ -465,7 +516,8 @@ void foo(int);
 )");
 
         module_index mindex;
-        register_module_entities(mindex, comments, file->file());
+        register_modules(mindex, comments, file->file());
+        register_module_entities(mindex, file->file());
 
         auto result = mindex.generate();
         REQUIRE(markup::as_xml(*result) == R"*(<module-index id="module-index">
@@ -6,6 +6,8 @@
 
 #include "../external/catch/single_include/catch2/catch.hpp"
 
+#include <sstream>
+
 #include <standardese/markup/document.hpp>
 
 #include "test_parser.hpp"
@@ -167,4 +169,46 @@ void context3();
 
         REQUIRE(!l.lookup_documentation(nullptr, "std_bar"));
     }
+    SECTION("nested external doc")
+    {
+        l.register_external("std", "std/$$/");
+        l.register_external("std::experimental", "exp/$$#$$");
+        l.register_external("boost::asio", "asio/$$");
+
+        REQUIRE(equal_destination(l.lookup_documentation(nullptr, "std::foo"), "std/std::foo/"));
+        REQUIRE(equal_destination(l.lookup_documentation(nullptr, "std::experimental::foo"),
+                                  "exp/std::experimental::foo#std::experimental::foo"));
+        REQUIRE(equal_destination(l.lookup_documentation(nullptr, "std::filesystem::path"),
+                                  "std/std::filesystem::path/"));
+        REQUIRE(equal_destination(l.lookup_documentation(nullptr, "boost::asio::io_context"),
+                                  "asio/boost::asio::io_context"));
+
+        REQUIRE(!l.lookup_documentation(nullptr, "boost::optional"));
+        REQUIRE(!l.lookup_documentation(nullptr, "std"));
+    }
+    SECTION("link table")
+    {
+        REQUIRE(l.register_documentation("foo", *document_a, markup::block_id("foo"), false));
+        REQUIRE(l.register_documentation("ns::bar(int)", *document_a,
+                                         markup::block_id("ns::bar(int)"), false));
+
+        std::ostringstream table;
+        l.export_link_table(table, "html");
+
+        linker other;
+        REQUIRE(other.register_documentation("foo", *document_b, markup::block_id("foo"), false));
+        other.import_link_table(table.str(), "https://example.com/");
+
+        // own documentation is preferred
+        REQUIRE(equal_destination(other.lookup_documentation(nullptr, "foo"), *document_b,
+                                  markup::block_id("foo")));
+        REQUIRE(equal_destination(other.lookup_documentation(nullptr, "ns::bar(int)"),
+                                  "https://example.com/a.html#standardese-ns__bar-int-"));
+        REQUIRE(equal_destination(other.lookup_documentation(nullptr, "ns::bar"),
+                                  "https://example.com/a.html#standardese-ns__bar-int-"));
+        REQUIRE(!other.lookup_documentation(nullptr, "baz"));
+
+        REQUIRE_THROWS_AS(other.import_link_table(table.str().substr(0u, 20u), ""),
+                          std::runtime_error);
+    }
 }
@@ -7,6 +7,7 @@
 #include "../external/catch/single_include/catch2/catch.hpp"
 
 #include <standardese/markup/generator.hpp>
+#include <standardese/markup/link.hpp>
 
 using namespace standardese::markup;
 
@@ -96,3 +97,41 @@ void foo();
 ```
 )");
 }
+
+TEST_CASE("code-block::token", "[markup]")
+{
+    auto xml =
+        R"(<code-block id="foo" language="cpp"><code-block-keyword>int</code-block-keyword>   <documentation-link unresolved-destination-id="bar"><code-block-identifier>bar</code-block-identifier></documentation-link><code-block-punctuation>;</code-block-punctuation><soft-break></soft-break>
+</code-block>
+)";
+
+    documentation_link::builder link("bar");
+    link.add_child(code_block::identifier::build("bar"));
+
+    code_block::builder builder(block_id("foo"), "cpp");
+    builder.add_token(code_block::token_kind::keyword, "int");
+    builder.add_token(code_block::token_kind::text, " ");
+    builder.add_child(text::build("  "));
+    builder.add_child(link.finish());
+    builder.add_token(code_block::token_kind::punctuation, ";");
+    builder.add_token(code_block::token_kind::soft_break, "\n");
+
+    auto ptr = builder.finish();
+    REQUIRE(std::distance(ptr->begin(), ptr->end()) == 1);
+
+    std::vector<code_block::token_kind> kinds;
+    ptr->for_each_token([&](const code_block::token& token) { kinds.push_back(token.kind()); });
+    REQUIRE(kinds
+            == std::vector<code_block::token_kind>{code_block::token_kind::keyword,
+                                                   code_block::token_kind::text,
+                                                   code_block::token_kind::entity,
+                                                   code_block::token_kind::punctuation,
+                                                   code_block::token_kind::soft_break});
+
+    REQUIRE(as_xml(*ptr) == xml);
+    REQUIRE(as_xml(*ptr->clone()) == xml);
+    REQUIRE(render(markdown_generator(false, "", "md"), *ptr) == R"(``` cpp
+int   bar;
+```
+)");
+}
@@ -6,6 +6,8 @@
 
 #include "../external/catch/single_include/catch2/catch.hpp"
 
+#include <algorithm>
+
 #include <cppast/cpp_file.hpp>
 #include <cppast/cpp_namespace.hpp>
 #include <standardese/markup/code_block.hpp>
@@ -14,6 +16,7 @@
 #include <standardese/markup/heading.hpp>
 #include <standardese/markup/list.hpp>
 #include <standardese/markup/paragraph.hpp>
+#include <standardese/markup/quote.hpp>
 
 using namespace standardese::markup;
 
@@ -157,3 +160,80 @@ The details documentation.
     REQUIRE(as_xml(*ptr) == xml);
     REQUIRE(as_markdown(*ptr) == md);
 }
+
+TEST_CASE("list_section", "[markup]")
+{
+    auto html = R"(<section id="standardese-a" class="standardese-entity-documentation">
+<h2 class="standardese-entity-documentation-heading">Entity A</h2>
+<pre><code class="standardese-language-cpp standardese-entity-synopsis">void a();</code></pre>
+<h4 class="standardese-list-section-heading">List</h4>
+<ul id="standardese-a-list" class="standardese-list-section">
+<li>
+<blockquote>
+<p>some text</p>
+<p>some more text</p>
+</blockquote>
+</li>
+<li>
+<p>text</p>
+</li>
+</ul>
+</section>
+<hr class="standardese-entity-documentation-break" />
+)";
+    auto xml  = R"(<entity-documentation id="a">
+<heading>Entity A</heading>
+<code-block language="cpp">void a();</code-block>
+<list-section name="List">
+<list-item>
+<block-quote>
+<paragraph>some text</paragraph>
+<paragraph>some more text</paragraph>
+</block-quote>
+</list-item>
+<list-item>
+<paragraph>text</paragraph>
+</list-item>
+</list-section>
+</entity-documentation>
+)";
+    // the list is tight, but the paragraphs of the quote are not directly inside the item
+    auto md = std::string(R"(## Entity A
+
+<span id="standardese-a"></span>
+
+<pre><code class="standardese-language-cpp">void a();</code></pre>
+
+#### List
+
+  - > some text
+    >$
+    > some more text
+  - text
+
+-----
+)");
+    std::replace(md.begin(), md.end(), '$', ' ');
+
+    block_quote::builder quote(block_id{});
+    quote.add_child(paragraph::builder().add_child(text::build("some text")).finish());
+    quote.add_child(paragraph::builder().add_child(text::build("some more text")).finish());
+
+    unordered_list::builder list(block_id("a-list"));
+    list.add_item(list_item::build(quote.finish()));
+    list.add_item(
+        list_item::build(paragraph::builder().add_child(text::build("text")).finish()));
+
+    cppast::cpp_namespace::builder entity("foo", false, false);
+
+    entity_documentation::builder builder(type_safe::ref(entity.get()), block_id("a"),
+                                          documentation_header(heading::build(block_id(),
+                                                                              "Entity A")),
+                                          code_block::build(block_id(), "cpp", "void a();"));
+    builder.add_section(list_section::build("List", list.finish()));
+
+    auto ptr = builder.finish()->clone();
+    REQUIRE(as_html(*ptr) == html);
+    REQUIRE(as_xml(*ptr) == xml);
+    REQUIRE(as_markdown(*ptr) == md);
+}
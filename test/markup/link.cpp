@@ -38,6 +38,13 @@ TEST_CASE("external_link", "[markup]")
     REQUIRE(as_markdown(*b_ptr)
             == "[with title](foo/bar/\\<%20&\\> \"title\\\"\")\n"); // MSVC doesn't like a raw
                                                                     // string here :(
+
+    external_link::builder c(url("http://foonathan.net"));
+    c.add_child(text::build("http://"));
+    c.add_child(text::build("foonathan.net"));
+
+    auto c_ptr = c.finish()->clone();
+    REQUIRE(as_markdown(*c_ptr) == "<http://foonathan.net>\n");
 }
 
 TEST_CASE("documentation_link", "[markup]")
@@ -5,7 +5,14 @@
 #ifndef STANDARDESE_FILESYSTEM_HPP_INCLUDED
 #define STANDARDESE_FILESYSTEM_HPP_INCLUDED
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <boost/filesystem.hpp>
@@ -60,6 +67,84 @@ namespace detail
         return true;
     }
 
+    // the valid files in the directory tree of root, with their paths relative to it
+    //
+    // The directories are listed by multiple threads,
+    // as listing a directory can take a while on network filesystems.
+    inline std::vector<std::pair<fs::path, fs::path>> list_directory(
+        const fs::path& root, const blacklist& extensions, const blacklist& files,
+        const blacklist& dirs, bool blacklist_dotfiles, unsigned no_threads)
+    {
+        std::vector<std::pair<fs::path, fs::path>> result;
+
+        std::mutex              mutex;
+        std::condition_variable cv;
+        std::vector<fs::path>   pending{root};
+        auto                    busy = 0u;
+        std::exception_ptr      exception;
+
+        auto worker = [&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                cv.wait(lock, [&] { return !pending.empty() || busy == 0u || exception; });
+                if (pending.empty() || exception)
+                    // nothing left to do or no point in continuing
+                    break;
+
+                auto dir = std::move(pending.back());
+                pending.pop_back();
+                ++busy;
+                lock.unlock();
+
+                std::vector<std::pair<fs::path, fs::path>> dir_files;
+                std::vector<fs::path>                      subdirs;
+                std::exception_ptr                         dir_exception;
+                try
+                {
+                    for (auto& entry : fs::directory_iterator(dir))
+                    {
+                        auto& cur      = entry.path();
+                        auto  relative = get_relative_path(cur, root);
+                        if (!is_valid(cur, relative, extensions, files, dirs, blacklist_dotfiles))
+                            continue;
+                        else if (!fs::is_directory(cur))
+                            dir_files.emplace_back(cur, std::move(relative));
+                        else if (!fs::is_symlink(cur))
+                            // like the recursive directory iterator, symlinks are not followed
+                            subdirs.push_back(cur);
+                    }
+                }
+                catch (...)
+                {
+                    dir_exception = std::current_exception();
+                }
+
+                lock.lock();
+                --busy;
+                std::move(dir_files.begin(), dir_files.end(), std::back_inserter(result));
+                std::move(subdirs.begin(), subdirs.end(), std::back_inserter(pending));
+                if (dir_exception && !exception)
+                    exception = dir_exception;
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (auto i = 1u; i < no_threads; ++i)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+
+        if (exception)
+            std::rethrow_exception(exception);
+
+        // the order would depend on the scheduling otherwise
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
     inline bool is_source_file(const fs::path& path, const whitelist& source_extensions)
     {
         auto ext = path.extension();
@@ -74,10 +159,11 @@ namespace detail
 // if given path is normal file and valid, calls f for it
 // otherwise recursively traverses through the given directory and calls f for each valid file
 // returns false if path was a normal file that was marked as invalid, true otherwise
+// directories are traversed using the given number of threads, but f is called on this thread
 template <typename Fun>
 bool handle_path(const fs::path& path, const whitelist& source_extensions,
                  const blacklist& extensions, const blacklist& files, blacklist dirs,
-                 bool blacklist_dotfiles, bool force_blacklist, Fun f)
+                 bool blacklist_dotfiles, bool force_blacklist, unsigned no_threads, Fun f)
 {
     // remove trailing slash if any
     // otherwise Boost.Filesystem can't handle it
@@ -89,22 +175,9 @@ bool handle_path(const fs::path& path, const whitelist& source_extensions,
 
     if (fs::is_directory(path))
     {
-        auto end = fs::recursive_directory_iterator();
-        for (auto iter = fs::recursive_directory_iterator(path); iter != end; ++iter)
-        {
-            auto& cur      = iter->path();
-            auto  relative = detail::get_relative_path(cur, path);
-
-            if (fs::is_directory(cur))
-            {
-                if (!detail::is_valid(cur, relative, extensions, files, dirs, blacklist_dotfiles))
-                    iter.no_push();
-            }
-            else if (detail::is_valid(cur, relative, extensions, files, dirs, blacklist_dotfiles))
-            {
-                f(detail::is_source_file(cur, source_extensions), cur, relative);
-            }
-        }
+        for (auto& file : detail::list_directory(path, extensions, files, dirs,
+                                                 blacklist_dotfiles, no_threads))
+            f(detail::is_source_file(file.first, source_extensions), file.first, file.second);
     }
     else if (!fs::exists(path))
         throw std::runtime_error("file '" + path.generic_string() + "' does not exist");
@@ -4,7 +4,23 @@
 
 #include "generator.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+
+#include <cppast/code_generator.hpp>
+#include <cppast/cpp_preprocessor.hpp>
+#include <cppast/visitor.hpp>
 
 #include <standardese/index.hpp>
 #include <standardese/linker.hpp>
@@ -13,33 +29,233 @@
 
 using namespace standardese_tool;
 
+namespace
+{
+// reports files whose parsing takes longer than a threshold
+//
+// libclang cannot be interrupted, but this at least tells which file is to blame.
+class parse_watchdog
+{
+public:
+    // a threshold of zero disables it
+    explicit parse_watchdog(std::chrono::seconds threshold) : threshold_(threshold), done_(false)
+    {
+        if (threshold_.count() > 0)
+            thread_ = std::thread([this] { run(); });
+    }
+
+    parse_watchdog(const parse_watchdog&) = delete;
+    parse_watchdog& operator=(const parse_watchdog&) = delete;
+
+    ~parse_watchdog() noexcept
+    {
+        if (!thread_.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    // watches the parsing of a file for the lifetime of the object,
+    // so the file is no longer reported once its parsing is done or has failed
+    class scope
+    {
+    public:
+        scope(parse_watchdog& watchdog, const std::string& path) : watchdog_(watchdog), path_(path)
+        {
+            watchdog_.begin(path_);
+        }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+        ~scope() noexcept
+        {
+            watchdog_.end(path_);
+        }
+
+    private:
+        parse_watchdog&    watchdog_;
+        const std::string& path_;
+    };
+
+private:
+    void begin(const std::string& path)
+    {
+        if (!thread_.joinable())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_.emplace(path, file{std::chrono::steady_clock::now(), false});
+    }
+
+    void end(const std::string& path) noexcept
+    {
+        if (!thread_.joinable())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_.erase(path);
+    }
+
+    struct file
+    {
+        std::chrono::steady_clock::time_point start;
+        bool                                  reported;
+    };
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, std::chrono::seconds(1), [&] { return done_; }))
+        {
+            auto now = std::chrono::steady_clock::now();
+            for (auto& cur : active_)
+                if (!cur.second.reported && now - cur.second.start > threshold_)
+                {
+                    std::clog << "warning: parsing '" << cur.first << "' takes longer than "
+                              << threshold_.count() << "s\n";
+                    cur.second.reported = true;
+                }
+        }
+    }
+
+    std::chrono::seconds        threshold_;
+    std::map<std::string, file> active_;
+    std::mutex                  mutex_;
+    std::condition_variable     cv_;
+    bool                        done_;
+    std::thread                 thread_;
+};
+} // namespace
+
+void standardese_tool::sort_by_cost(std::vector<input_file>& files, const parse_timings& timings)
+{
+    struct cost
+    {
+        std::uintmax_t              size;
+        type_safe::optional<double> time;
+    };
+
+    // the files with a known parse time tell how long parsing a byte takes
+    std::vector<cost> costs;
+    costs.reserve(files.size());
+    auto known_size = 0.0, known_time = 0.0;
+    for (auto& file : files)
+    {
+        boost::system::error_code ec;
+        auto                      size = fs::file_size(file.path, ec);
+        if (ec)
+            size = 0u;
+
+        auto path = fs::canonical(file.path, ec);
+        auto iter = ec ? timings.end() : timings.find(path.generic_string());
+        if (iter != timings.end())
+        {
+            costs.push_back({size, iter->second});
+            known_size += double(size);
+            known_time += iter->second;
+        }
+        else
+            costs.push_back({size, type_safe::nullopt});
+    }
+
+    auto time_per_byte = known_size > 0.0 ? known_time / known_size : 0.0;
+    auto get_cost      = [&](const cost& c) {
+        if (c.time)
+            return c.time.value();
+        else if (time_per_byte > 0.0)
+            return double(c.size) * time_per_byte;
+        else
+            // no timings at all, so only the sizes are compared
+            return double(c.size);
+    };
+
+    std::vector<std::size_t> order(files.size());
+    for (auto i = std::size_t(0); i != order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+        return get_cost(costs[lhs]) > get_cost(costs[rhs]);
+    });
+
+    std::vector<input_file> sorted;
+    sorted.reserve(files.size());
+    for (auto i : order)
+        sorted.push_back(std::move(files[i]));
+    files = std::move(sorted);
+}
+
+parse_timings standardese_tool::read_timings(const fs::path& file)
+{
+    parse_timings result;
+
+    // a missing file is not an error, it is written after the first run
+    std::ifstream in(file.string());
+    double        time;
+    std::string   path;
+    while (in >> time && std::getline(in >> std::ws, path))
+        result[path] = time;
+
+    return result;
+}
+
+void standardese_tool::write_timings(const fs::path& file, const std::vector<parsed_file>& files)
+{
+    std::ofstream out(file.string());
+    if (!out)
+        throw std::runtime_error("unable to write parse timings to '" + file.generic_string()
+                                 + "'");
+
+    for (auto& parsed : files)
+        out << parsed.parse_time << ' ' << parsed.file->name() << '\n';
+}
+
 type_safe::optional<std::vector<parsed_file>> standardese_tool::parse(
     const cppast::libclang_compile_config&                            config,
     const type_safe::optional<cppast::libclang_compilation_database>& database,
-    const std::vector<input_file>& files, const cppast::cpp_entity_index& index,
-    unsigned no_threads)
+    const std::vector<input_file>&                                    files,
+    const std::shared_ptr<const cppast::cpp_entity_index>& index, bool fast_preprocessing,
+    unsigned no_threads, std::chrono::seconds slow_parse_warning)
 {
-    std::vector<parsed_file> result;
-    bool                     error(false);
-    cppast::libclang_parser  parser(cppast::default_logger());
+    // the results keep the order of the files, so the later stages process them in that order too
+    std::vector<parsed_file> result(files.size());
+    std::atomic<bool>        error(false);
+    parse_watchdog           watchdog(slow_parse_warning);
 
     {
-        std::mutex  mutex;
         thread_pool pool(no_threads);
-        for (auto& file : files)
+        for (auto i = std::size_t(0); i != files.size(); ++i)
         {
-            add_job(pool, [&, file] {
-                auto db_config = database.map([&](const cppast::libclang_compilation_database& db) {
+            add_job(pool, [&, i] {
+                // threads sharing a parser share its libclang index and contend for its locks,
+                // so every thread of the pool has its own
+                thread_local cppast::libclang_parser parser(cppast::default_logger());
+
+                auto& file       = files[i];
+                auto  config_for = [&](const cppast::libclang_compilation_database& db) {
                     return cppast::find_config_for(db, file.path.generic_string());
-                });
+                };
 
-                auto actual_config = db_config.value_or(config);
-                auto parsed
-                    = parser.parse(index, fs::canonical(file.path).generic_string(), actual_config);
+                auto actual_config = database.map(config_for).value_or(config);
+                // the database only provides the flags
+                actual_config.fast_preprocessing(fast_preprocessing);
+                auto path       = fs::canonical(file.path).generic_string();
+                auto start      = std::chrono::steady_clock::now();
+                auto file_index = index ? index : std::make_shared<cppast::cpp_entity_index>();
+                std::unique_ptr<cppast::cpp_file> parsed;
+                {
+                    parse_watchdog::scope watch(watchdog, path);
+                    parsed = parser.parse(*file_index, path, actual_config);
+                }
+                std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
 
-                std::lock_guard<std::mutex> lock(mutex);
                 if (parsed)
-                    result.push_back({std::move(parsed), file.relative.generic_string()});
+                    result[i] = {std::move(parsed), file.relative.generic_string(), time.count(),
+                                 std::move(file_index)};
                 else
                     error = true;
             });
@@ -52,6 +268,179 @@ type_safe::optional<std::vector<parsed_file>> standardese_tool::parse(
         return std::move(result);
 }
 
+namespace
+{
+// the path as the parser names the file, or the absolute path if it doesn't exist (anymore)
+std::string get_full_path(const fs::path& path)
+{
+    boost::system::error_code ec;
+    auto                      result = fs::canonical(path, ec);
+    return (ec ? fs::absolute(path) : result).generic_string();
+}
+
+std::vector<std::string> get_includes(const cppast::cpp_file& file)
+{
+    std::vector<std::string> result;
+    cppast::visit(file, [&](const cppast::cpp_entity& e, const cppast::visitor_info&) {
+        if (e.kind() == cppast::cpp_include_directive::kind())
+            result.push_back(
+                get_full_path(static_cast<const cppast::cpp_include_directive&>(e).full_path()));
+    });
+    return result;
+}
+} // namespace
+
+std::vector<parsed_file> standardese_tool::take_up_to_date(std::vector<parsed_file>&& previous,
+                                                           const std::vector<input_file>& files,
+                                                           const std::vector<fs::path>& changed)
+{
+    std::unordered_set<std::string> outdated;
+    for (auto& path : changed)
+        outdated.insert(get_full_path(path));
+
+    // a file that includes an outdated file, directly or indirectly, is outdated as well,
+    // as the macros and declarations it sees may have changed
+    std::vector<std::vector<std::string>> includes;
+    for (auto& parsed : previous)
+        includes.push_back(get_includes(*parsed.file));
+    for (auto done = false; !done;)
+    {
+        done = true;
+        for (auto i = std::size_t(0); i != previous.size(); ++i)
+            if (!outdated.count(previous[i].file->name())
+                && std::any_of(includes[i].begin(), includes[i].end(),
+                               [&](const std::string& include) {
+                                   return outdated.count(include) != 0u;
+                               }))
+            {
+                outdated.insert(previous[i].file->name());
+                done = false;
+            }
+    }
+
+    std::unordered_set<std::string> inputs;
+    for (auto& file : files)
+        inputs.insert(get_full_path(file.path));
+
+    std::vector<parsed_file> result;
+    for (auto& parsed : previous)
+        if (inputs.count(parsed.file->name()) && !outdated.count(parsed.file->name()))
+            result.push_back(std::move(parsed));
+    previous.clear();
+    return result;
+}
+
+std::vector<input_file> standardese_tool::get_unparsed(const std::vector<input_file>&  files,
+                                                       const std::vector<parsed_file>& parsed)
+{
+    std::unordered_set<std::string> names;
+    for (auto& file : parsed)
+        names.insert(file.file->name());
+
+    std::vector<input_file> result;
+    for (auto& file : files)
+        if (!names.count(get_full_path(file.path)))
+            result.push_back(file);
+    return result;
+}
+
+std::vector<fs::path> standardese_tool::get_dependencies(const std::vector<parsed_file>& files)
+{
+    std::unordered_set<std::string> names;
+    for (auto& file : files)
+        names.insert(file.file->name());
+
+    std::set<std::string> result;
+    for (auto& file : files)
+        for (auto& include : get_includes(*file.file))
+            if (!names.count(include))
+                result.insert(include);
+    return std::vector<fs::path>(result.begin(), result.end());
+}
+
+namespace
+{
+// collects the ids of all entities a synopsis refers to
+class reference_collector : public cppast::code_generator
+{
+public:
+    std::unordered_set<cppast::cpp_entity_id> ids;
+
+private:
+    bool do_write_reference(type_safe::array_ref<const cppast::cpp_entity_id> id,
+                            cppast::string_view) override
+    {
+        ids.insert(id.begin(), id.end());
+        return true;
+    }
+
+    void do_indent() override {}
+    void do_unindent() override {}
+    void do_write_token_seq(cppast::string_view) override {}
+    void do_write_newline() override {}
+    void do_write_whitespace() override {}
+};
+} // namespace
+
+void standardese_tool::register_entities(const cppast::cpp_entity_index&  index,
+                                         const std::vector<parsed_file>& files)
+{
+    // an index of a file only refers to the entities of its AST, which is alive as long as it is
+    std::vector<const cppast::cpp_entity_index*> others;
+    reference_collector                          collector;
+    for (auto& parsed : files)
+    {
+        if (parsed.index.get() == &index)
+            continue;
+        others.push_back(parsed.index.get());
+
+        // the synopsis doesn't refer to the files that are included
+        cppast::visit(*parsed.file, [&](const cppast::cpp_entity& e, const cppast::visitor_info&) {
+            if (e.kind() == cppast::cpp_include_directive::kind())
+            {
+                auto& include = static_cast<const cppast::cpp_include_directive&>(e);
+                collector.ids.insert(include.target().id().begin(), include.target().id().end());
+            }
+        });
+        cppast::generate_code(collector, *parsed.file);
+    }
+    if (others.empty())
+        return;
+
+    for (auto& id : collector.ids)
+    {
+        for (auto other : others)
+            for (auto& ns : other->lookup_namespace(id))
+                index.register_namespace(id, ns);
+
+        if (index.lookup_definition(id))
+            continue;
+
+        auto registered = false;
+        for (auto other : others)
+        {
+            auto definition = other->lookup_definition(id);
+            if (!definition)
+                continue;
+            else if (definition.value().kind() == cppast::cpp_file::kind())
+                index.register_file(id, type_safe::ref(static_cast<const cppast::cpp_file&>(
+                                            definition.value())));
+            else
+                index.register_definition(id, type_safe::ref(definition.value()));
+            registered = true;
+            break;
+        }
+
+        if (!registered && !index.lookup(id))
+            for (auto other : others)
+                if (auto declaration = other->lookup(id))
+                {
+                    index.register_forward_declaration(id, type_safe::ref(declaration.value()));
+                    break;
+                }
+    }
+}
+
 standardese::comment_registry standardese_tool::parse_comments(
     const standardese::comment::config& config, const std::vector<parsed_file>& files,
     unsigned no_threads)
@@ -67,29 +456,31 @@ standardese::comment_registry standardese_tool::parse_comments(
 
 std::vector<std::unique_ptr<standardese::doc_cpp_file>> standardese_tool::build_files(
     const standardese::comment_registry& registry, const cppast::cpp_entity_index& index,
-    std::vector<parsed_file>&& files, const standardese::entity_blacklist& blacklist,
+    std::vector<parsed_file>& files, const standardese::entity_blacklist& blacklist,
     bool hide_uncommented, unsigned no_threads)
 {
     {
+        // base classes are usually shared between files
+        standardese::base_exclusion_cache cache;
+
         thread_pool pool(no_threads);
         for (auto& file : files)
-            add_job(pool,
-                    [&] { standardese::exclude_entities(registry, index, blacklist, hide_uncommented, *file.file); });
+            add_job(pool, [&] {
+                standardese::exclude_entities(registry, index, blacklist, hide_uncommented,
+                                              *file.file, cache);
+            });
     }
 
-    std::vector<std::unique_ptr<standardese::doc_cpp_file>> result;
+    // keep the order of the files
+    std::vector<std::unique_ptr<standardese::doc_cpp_file>> result(files.size());
 
     {
-        std::mutex  mutex;
         thread_pool pool(no_threads);
-        for (auto& file : files)
-            add_job(pool, [&] {
-                auto entity = standardese::build_doc_entities(type_safe::ref(registry), index,
-                                                              std::move(file.file),
-                                                              std::move(file.output_name));
-
-                std::lock_guard<std::mutex> lock(mutex);
-                result.push_back(std::move(entity));
+        for (auto i = std::size_t(0); i != files.size(); ++i)
+            add_job(pool, [&, i] {
+                result[i] = standardese::build_doc_entities(type_safe::ref(registry), index,
+                                                            std::move(files[i].file),
+                                                            files[i].output_name);
             });
     }
 
@@ -123,24 +514,37 @@ documents standardese_tool::generate(
     {
         thread_pool pool(no_threads);
 
+        // large files and namespaces fork the generation of their children into the same pool
+        auto file_config = gen_config;
+        if (no_threads > 1u)
+            file_config.set_executor(
+                [&](std::function<void()> task) { add_job(pool, std::move(task)); }, no_threads);
+
+        // modules are shared between files, so their documentation is built up front
+        for (auto& file : files)
+            standardese::register_modules(mindex, comments, file->file());
+
         std::vector<std::future<void>> futures;
         for (auto& file : files)
             futures.push_back(add_job(pool, [&] {
+                // the indices copy the briefs, so they are registered first,
+                // as the generation takes the parsed sections out of the comments
+                standardese::register_index_entities(eindex, file->file());
+                standardese::register_module_entities(mindex, file->file());
+                findex.register_file(file->link_name(), file->output_name(),
+                                     file->comment() ? file->comment().value().brief_section()
+                                                     : nullptr);
+
                 standardese::markup::subdocument::builder document(file->output_name(),
                                                                    "doc_"
                                                                        + get_output_file_name(
                                                                              file->output_name()));
                 document.add_child(
-                    standardese::generate_documentation(gen_config, syn_config, index, *file));
+                    standardese::generate_documentation(file_config, syn_config, index, *file));
                 auto finished_doc = document.finish();
 
                 standardese::register_documentations(*cppast::default_logger(), linker,
                                                      *finished_doc);
-                standardese::register_index_entities(eindex, file->file());
-                standardese::register_module_entities(mindex, comments, file->file());
-                findex.register_file(file->link_name(), file->output_name(),
-                                     file->comment() ? file->comment().value().brief_section()
-                                                     : nullptr);
 
                 std::lock_guard<std::mutex> lock(result_mutex);
                 result.push_back(std::move(finished_doc));
@@ -150,32 +554,106 @@ documents standardese_tool::generate(
             future.get(); // to retrieve exceptions
     }
 
-    auto eindex_doc = get_index_document(eindex.generate(gen_config.order()), "Entities",
-                                         "standardese_entities");
-    standardese::register_documentations(*cppast::default_logger(), linker, *eindex_doc);
-    result.push_back(std::move(eindex_doc));
+    {
+        thread_pool pool(no_threads);
+
+        // the index documents only register link names that the other documents may refer to,
+        // so they can be generated in parallel, but must be registered before resolving,
+        // which happens in a fixed order, so duplicates are always reported the same way
+        auto eindex_doc = add_job(pool, [&] {
+            return get_index_document(eindex.generate(gen_config.order()), "Entities",
+                                      "standardese_entities");
+        });
+        auto findex_doc = add_job(pool, [&] {
+            return get_index_document(findex.generate(), "Files", "standardese_files");
+        });
+        auto mindex_doc = add_job(pool, [&] {
+            return get_index_document(mindex.generate(), "Modules", "standardese_modules");
+        });
+
+        for (auto doc : {&eindex_doc, &findex_doc, &mindex_doc})
+        {
+            result.push_back(doc->get());
+            standardese::register_documentations(*cppast::default_logger(), linker,
+                                                 *result.back());
+        }
+    }
 
-    auto findex_doc = get_index_document(findex.generate(), "Files", "standardese_files");
-    standardese::register_documentations(*cppast::default_logger(), linker, *findex_doc);
-    result.push_back(std::move(findex_doc));
+    {
+        thread_pool pool(no_threads);
 
-    auto mindex_doc = get_index_document(mindex.generate(), "Modules", "standardese_modules");
-    standardese::register_documentations(*cppast::default_logger(), linker, *mindex_doc);
-    result.push_back(std::move(mindex_doc));
+        // the linker is fully populated now and each document only modifies its own links
+        std::vector<std::future<void>> futures;
+        for (auto& doc : result)
+            futures.push_back(add_job(pool, [&] {
+                standardese::resolve_links(*cppast::default_logger(), linker, *doc);
+            }));
 
-    for (auto& doc : result)
-        standardese::resolve_links(*cppast::default_logger(), linker, *doc);
+        for (auto& future : futures)
+            future.get(); // to retrieve exceptions
+    }
 
     return result;
 }
 
+namespace
+{
+bool has_content(const fs::path& path, const std::string& content)
+{
+    // in text mode, the file may be bigger because of line ending conversions, but not smaller
+    boost::system::error_code ec;
+    if (fs::file_size(path, ec) < content.size() || ec)
+        return false;
+
+    // read one character more to tell whether the file is longer
+    std::ifstream file(path.string());
+    std::string   existing(content.size() + 1u, '\0');
+    file.read(&existing[0], std::streamsize(existing.size()));
+    existing.resize(std::size_t(file.gcount()));
+    return existing == content;
+}
+
+// writes the content only if the file doesn't already have it,
+// so tools watching the output only see the files that have actually changed
+void write_if_changed(const fs::path& path, const std::string& content)
+{
+    if (has_content(path, content))
+        return;
+
+    // readers never see a partially written file, as the rename replaces it atomically
+    auto tmp = path;
+    tmp += ".tmp";
+    try
+    {
+        {
+            std::ofstream file(tmp.string());
+            file.write(content.data(), std::streamsize(content.size()));
+            if (!file.flush())
+                throw std::runtime_error("unable to write '" + tmp.generic_string() + "'");
+        }
+        fs::rename(tmp, path);
+    }
+    catch (...)
+    {
+        boost::system::error_code ec;
+        fs::remove(tmp, ec);
+        throw;
+    }
+}
+} // namespace
+
 void standardese_tool::write_files(const documents& docs, standardese::markup::generator generator,
                                    std::string prefix, const char* extension, unsigned no_threads)
 {
     thread_pool pool(no_threads);
+
+    std::vector<std::future<void>> futures;
     for (auto& doc : docs)
-        add_job(pool, [&] {
-            std::ofstream file(prefix + doc->output_name().file_name(extension));
-            generator(file, *doc);
-        });
+        futures.push_back(add_job(pool, [&] {
+            write_if_changed(prefix + doc->output_name().file_name(extension),
+                             standardese::markup::render(generator, *doc));
+        }));
+
+    for (auto& future : futures)
+        future.get(); // to retrieve exceptions
 }
@@ -5,6 +5,10 @@
 #ifndef STANDARDESE_TOOL_GENERATOR_HPP_INCLUDED
 #define STANDARDESE_TOOL_GENERATOR_HPP_INCLUDED
 
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <cppast/cpp_entity_index.hpp>
@@ -29,23 +33,59 @@ struct input_file
 
 struct parsed_file
 {
-    std::unique_ptr<cppast::cpp_file> file;
-    std::string                       output_name;
+    std::unique_ptr<cppast::cpp_file>               file;
+    std::string                                     output_name;
+    double                                          parse_time; // in seconds
+    std::shared_ptr<const cppast::cpp_entity_index> index;      // the file was parsed into
 };
 
+// the time it took to parse the files in seconds, by full path
+using parse_timings = std::map<std::string, double>;
+
+// orders the files so that the most expensive ones come first
+// the cost of a file is its parse time, if known, or estimated from its size
+void sort_by_cost(std::vector<input_file>& files, const parse_timings& timings);
+
+// reads the timings written by a previous run, there are none if the file doesn't exist
+parse_timings read_timings(const fs::path& file);
+
+void write_timings(const fs::path& file, const std::vector<parsed_file>& files);
+
+// the results have the same order as the files
+// if no index is given, every file is parsed into an index of its own
 type_safe::optional<std::vector<parsed_file>> parse(
     const cppast::libclang_compile_config&                            config,
     const type_safe::optional<cppast::libclang_compilation_database>& database,
-    const std::vector<input_file>& files, const cppast::cpp_entity_index& index,
-    unsigned no_threads);
+    const std::vector<input_file>&                                    files,
+    const std::shared_ptr<const cppast::cpp_entity_index>& index, bool fast_preprocessing,
+    unsigned no_threads, std::chrono::seconds slow_parse_warning);
+
+// takes the files of a previous run that are still up to date,
+// i.e. that are still input files and neither changed nor include a changed input file
+std::vector<parsed_file> take_up_to_date(std::vector<parsed_file>&&     previous,
+                                         const std::vector<input_file>& files,
+                                         const std::vector<fs::path>&   changed);
+
+// the input files that aren't parsed already
+std::vector<input_file> get_unparsed(const std::vector<input_file>&  files,
+                                     const std::vector<parsed_file>& parsed);
+
+// the files the files include that aren't parsed themselves, e.g. headers that aren't input files
+std::vector<fs::path> get_dependencies(const std::vector<parsed_file>& files);
+
+// registers the entities of files parsed into an index of their own in the given one,
+// as far as any of the files refers to them
+void register_entities(const cppast::cpp_entity_index&  index,
+                       const std::vector<parsed_file>& files);
 
 standardese::comment_registry parse_comments(const standardese::comment::config& config,
                                              const std::vector<parsed_file>&     files,
                                              unsigned                            no_threads);
 
+// the ASTs are moved out of the files
 std::vector<std::unique_ptr<standardese::doc_cpp_file>> build_files(
     const standardese::comment_registry& registry, const cppast::cpp_entity_index& index,
-    std::vector<parsed_file>&& files, const standardese::entity_blacklist& blacklist,
+    std::vector<parsed_file>& files, const standardese::entity_blacklist& blacklist,
     bool hide_uncommented, unsigned no_threads);
 
 using documents = std::vector<std::unique_ptr<standardese::markup::document_entity>>;
@@ -3,14 +3,20 @@
 // This file is subject to the license terms in the LICENSE file
 // found in the top-level directory of this distribution.
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
 
 #include <boost/program_options.hpp>
 
 #include "filesystem.hpp"
 #include "generator.hpp"
 #include "thread_pool.hpp"
+#include "watcher.hpp"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
@@ -184,6 +190,7 @@ std::vector<standardese_tool::input_file> get_input(const po::variables_map& opt
         = get_option<std::vector<std::string>>(options, "input.blacklist_dir").value();
     auto blacklist_dotfiles = get_option<bool>(options, "input.blacklist_dotfiles").value();
     auto force_blacklist    = get_option<bool>(options, "input.force_blacklist").value();
+    auto no_threads         = get_option<unsigned>(options, "jobs").value();
 
     auto input_files = get_option<std::vector<fs::path>>(options, "input-files");
     if (!input_files)
@@ -193,6 +200,7 @@ std::vector<standardese_tool::input_file> get_input(const po::variables_map& opt
     for (auto& file : input_files.value())
         standardese_tool::handle_path(file, source_ext, blacklist_ext, blacklist_files,
                                       blacklist_dirs, blacklist_dotfiles, force_blacklist,
+                                      no_threads,
                                       [&](bool, const fs::path& path, const fs::path& relative) {
                                           files.push_back({path, relative});
                                       });
@@ -238,6 +246,8 @@ standardese::generation_config get_generation_config(const po::variables_map& op
                     !get_option<bool>(options, "input.hide_uncommented").value());
     config.set_flag(standardese::generation_config::inline_doc,
                     get_option<bool>(options, "output.inline_doc").value());
+    config.set_parallel_threshold(
+        get_option<unsigned>(options, "output.parallel_threshold").value());
 
     auto order = get_option<std::string>(options, "output.entity_index_order").value();
     if (order == "namespace_inline_sorted")
@@ -314,6 +324,22 @@ void register_external_documentations(standardese::linker& l, const po::variable
         auto url     = arg.substr(equal + 1u);
         l.register_external(std::move(ns_name), std::move(url));
     }
+
+    auto tables = get_option<std::vector<std::string>>(options, "comment.link_table").value();
+    for (auto& arg : tables)
+    {
+        auto equal = arg.find('=');
+        if (equal == std::string::npos)
+            throw std::invalid_argument("invalid format for link table '" + arg + "'");
+
+        auto          file_name = arg.substr(0, equal);
+        std::ifstream file(file_name, std::ios::binary);
+        if (!file)
+            throw std::invalid_argument("unable to read link table '" + file_name + "'");
+
+        std::string table{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        l.import_link_table(std::move(table), arg.substr(equal + 1u));
+    }
 }
 
 int main(int argc, char* argv[])
@@ -327,7 +353,9 @@ int main(int argc, char* argv[])
         ("verbose,v", po::value<bool>()->implicit_value(true)->default_value(false),
          "prints more information")
         ("jobs,j", po::value<unsigned>()->default_value(standardese_tool::default_no_threads()),
-         "sets the number of threads to use");
+         "sets the number of threads to use")
+        ("watch,w", po::value<bool>()->implicit_value(true)->default_value(false),
+         "keeps running and generates the documentation again whenever an input file changes");
 
     configuration.add_options()
         ("input.source_ext",
@@ -383,6 +411,13 @@ int main(int argc, char* argv[])
         ("compilation.ms_compatibility",
          po::value<bool>()->implicit_value(true)->default_value(default_msvc_comp()),
          "enable/disable MSVC compatibility (-fms-compatibility)")
+        ("compilation.slow_parse_warning", po::value<unsigned>()->default_value(0u),
+         "the time in seconds after which a warning names a file that is still being parsed, 0 to disable, the parsing is not aborted")
+        ("compilation.timings", po::value<std::string>(),
+         "a file the parse times are written to, so that the next run parses the slowest files first instead of the biggest ones")
+        ("compilation.fast_preprocessing",
+         po::value<bool>()->implicit_value(true)->default_value(false),
+         "preprocess only the input files themselves and not the files they include, this breaks if a file defines the same macro multiple times or relies on the order of macro directives")
         ("compilation.keep_comments_in_macro",
          po::value<bool>()->implicit_value(true)->default_value(false),
          "disable/enable removal of comments during macro evaluation (-CC)")
@@ -393,6 +428,8 @@ int main(int argc, char* argv[])
          "set the regular expression to detect a command, e.g., `--comment.command_pattern 'returns=RETURNS:'` or `'returns|=RETURNS:'` to also keep the original pattern.")
         ("comment.external_doc", po::value<std::vector<std::string>>()->default_value({}, ""),
          "syntax is namespace=url, supports linking to a different URL for entities in a certain namespace")
+        ("comment.link_table", po::value<std::vector<std::string>>()->default_value({}, ""),
+         "syntax is file=url, supports linking to the documentation of another project using the link table it has written, url is the prefix of its files")
         ("comment.free_file_comments", po::value<bool>()->implicit_value(true)->default_value(standardese::comment::config::options().free_file_comments),
          "associate free comments to their entire file")
         ("comment.group_uncommented", po::value<bool>()->implicit_value(true)->default_value(standardese::comment::config::options().group_uncommented),
@@ -406,6 +443,8 @@ int main(int argc, char* argv[])
          "the output format used (html, commonmark, commonmark_html, xml, text)")
         ("output.link_extension", po::value<std::string>(),
          "the file extension of the links to entities, useful if you convert standardese output to a different format and change the extension")
+        ("output.link_table", po::value<std::string>(),
+         "a file the link table will be written to, so that other projects can link to this documentation")
         ("output.link_prefix", po::value<std::string>(),
         "a prefix that will be added to all links, if not specified they'll be relative links")
         ("output.entity_index_order", po::value<std::string>()->default_value("namespace_inline_sorted"),
@@ -415,6 +454,8 @@ int main(int argc, char* argv[])
          "the tab width (i.e. number of spaces, won't emit tab) of the code in the synthesis")
         ("output.inline_doc", po::value<bool>()->default_value(true)->implicit_value(true),
          "whether or not some entity documentation (parameters etc.) will be shown inline")
+        ("output.parallel_threshold", po::value<unsigned>()->default_value(0u),
+         "the minimal number of entities in a file or namespace so that their documentation is generated in parallel, 0 to disable")
         ("output.show_complex_noexcept", po::value<bool>()->default_value(true)->implicit_value(true),
          "whether or not complex noexcept expressions will be shown in the synopsis or replaced by \"see below\"")
         ("output.show_macro_replacement", po::value<bool>()->default_value(false)->implicit_value(true),
@@ -438,6 +479,10 @@ int main(int argc, char* argv[])
             auto compile_config = get_compile_config(options);
             auto database       = get_compilation_database(options);
             auto input          = get_input(options);
+            auto slow_parse     = std::chrono::seconds(
+                get_option<unsigned>(options, "compilation.slow_parse_warning").value());
+            auto fast_preprocessing
+                = get_option<bool>(options, "compilation.fast_preprocessing").value();
 
             auto comment_config    = get_comment_config(options);
             auto synopsis_config   = get_synopsis_config(options);
@@ -448,45 +493,189 @@ int main(int argc, char* argv[])
             auto formats = get_formats(options);
             auto prefix  = get_option<std::string>(options, "output.prefix").value();
 
-            standardese::linker linker;
-            register_external_documentations(linker, options);
+            auto watch = get_option<bool>(options, "watch").value();
 
-            try
-            {
-                cppast::cpp_entity_index index;
-
-                std::clog << "parsing C++ files...\n";
-                auto parsed
-                    = standardese_tool::parse(compile_config, database, input, index, no_threads);
-                if (!parsed)
-                    return 1;
-
-                std::clog << "parsing documentation comments...\n";
-                auto comments
-                    = standardese_tool::parse_comments(comment_config, parsed.value(), no_threads);
-                auto files
-                    = standardese_tool::build_files(comments, index, std::move(parsed.value()),
-                                                    blacklist, generation_config.is_flag_set(standardese::generation_config::hide_uncommented), no_threads);
-
-                std::clog << "generating documentation...\n";
-                auto docs = standardese_tool::generate(generation_config, synopsis_config, comments,
-                                                       index, linker, files, no_threads);
-
-                for (auto& format : formats)
+            // the files of the previous run in watch mode, only changed files are parsed again
+            std::vector<standardese_tool::parsed_file> previous;
+
+            auto run = [&](const std::vector<standardese_tool::input_file>& input_files,
+                           const std::vector<fs::path>&                     changed) {
+                // the linker is filled by the generation, so it is created for each run
+                standardese::linker linker;
+                register_external_documentations(linker, options);
+
+                try
                 {
-                    std::clog << "writing files in format '" << format.second << "'...\n";
-
-                    auto format_prefix
-                        = formats.size() > 1u ? std::string(format.second) + '/' + prefix : prefix;
-                    if (!format_prefix.empty())
-                        fs::create_directories(fs::path(format_prefix).parent_path());
-                    standardese_tool::write_files(docs, format.first, std::move(format_prefix),
-                                                  format.second, no_threads);
+                    // the index cannot forget the entities of changed files, so it is new as well
+                    // in watch mode, the files are parsed into indices of their own,
+                    // which are kept with their ASTs and registered in the index of every run
+                    auto index = std::make_shared<cppast::cpp_entity_index>();
+
+                    auto up_to_date
+                        = standardese_tool::take_up_to_date(std::move(previous), input_files,
+                                                            changed);
+
+                    // the most expensive files are parsed first, so they don't delay the end
+                    auto timings_file = get_option<std::string>(options, "compilation.timings");
+                    auto unparsed     = standardese_tool::get_unparsed(input_files, up_to_date);
+                    standardese_tool::sort_by_cost(unparsed,
+                                                   timings_file
+                                                       ? standardese_tool::read_timings(
+                                                           timings_file.value())
+                                                       : standardese_tool::parse_timings());
+
+                    std::clog << "parsing C++ files...\n";
+                    auto parsed
+                        = standardese_tool::parse(compile_config, database, unparsed,
+                                                  watch ? nullptr : index, fast_preprocessing,
+                                                  no_threads, slow_parse);
+                    if (!parsed)
+                    {
+                        // the files that failed are parsed again after the next change
+                        previous = std::move(up_to_date);
+                        return false;
+                    }
+
+                    auto files = std::move(parsed.value());
+                    std::move(up_to_date.begin(), up_to_date.end(), std::back_inserter(files));
+                    standardese_tool::register_entities(*index, files);
+                    if (timings_file)
+                        standardese_tool::write_timings(timings_file.value(), files);
+
+                    // the comments are connected across files, so they are all parsed again,
+                    // but only their metadata until the documentation needs the rest
+                    std::clog << "parsing documentation comments...\n";
+                    auto comments
+                        = standardese_tool::parse_comments(comment_config, files, no_threads);
+                    auto doc_files = standardese_tool::
+                        build_files(comments, *index, files, blacklist,
+                                    generation_config.is_flag_set(
+                                        standardese::generation_config::hide_uncommented),
+                                    no_threads);
+
+                    std::clog << "generating documentation...\n";
+                    auto docs = standardese_tool::generate(generation_config, synopsis_config,
+                                                           comments, *index, linker, doc_files,
+                                                           no_threads);
+
+                    if (auto table = get_option<std::string>(options, "output.link_table"))
+                    {
+                        std::clog << "writing link table...\n";
+
+                        auto extension = get_option<std::string>(options, "output.link_extension")
+                                             .value_or(formats.front().second);
+                        std::ofstream out(table.value(), std::ios::binary);
+                        if (!out)
+                            throw std::runtime_error("unable to open link table '" + table.value()
+                                                     + "'");
+                        linker.export_link_table(out, extension);
+                        if (!out.flush())
+                            throw std::runtime_error("unable to write link table '"
+                                                     + table.value() + "'");
+                    }
+
+                    for (auto& format : formats)
+                    {
+                        std::clog << "writing files in format '" << format.second << "'...\n";
+
+                        auto format_prefix = formats.size() > 1u
+                                                 ? std::string(format.second) + '/' + prefix
+                                                 : prefix;
+                        if (!format_prefix.empty())
+                            fs::create_directories(fs::path(format_prefix).parent_path());
+                        standardese_tool::write_files(docs, format.first,
+                                                      std::move(format_prefix), format.second,
+                                                      no_threads);
+                    }
+
+                    if (watch)
+                    {
+                        // the documents refer to the ASTs, so they are only taken back now
+                        for (auto i = std::size_t(0); i != files.size(); ++i)
+                            files[i].file = doc_files[i]->release_file();
+                        previous = std::move(files);
+                    }
                 }
-            }
-            catch (std::exception& ex)
+                catch (std::exception& ex)
+                {
+                    std::cerr << "error: " << ex.what() << '\n';
+                    return false;
+                }
+
+                return true;
+            };
+
+            if (!watch)
+                return run(input, {}) ? 0 : 1;
+
+            // the options, the compilation database and the ASTs of unchanged files are kept
+            // besides the input files, the files they include and the database are watched
+            auto database_file = get_option<std::string>(options, "compilation.commands_dir")
+                                     .map([](const std::string& dir) {
+                                         return fs::path(dir) / "compile_commands.json";
+                                     });
+            std::vector<fs::path> dependencies;
+            auto get_watched = [&](const std::vector<standardese_tool::input_file>& input_files) {
+                std::vector<fs::path> result;
+                for (auto& file : input_files)
+                    result.push_back(file.path);
+                result.insert(result.end(), dependencies.begin(), dependencies.end());
+                if (database_file)
+                    result.push_back(database_file.value());
+                return result;
+            };
+
+            auto snapshot = standardese_tool::get_snapshot(get_watched(input));
+            run(input, {});
+
+            standardese_tool::file_watcher
+                watcher(get_option<std::vector<fs::path>>(options, "input-files").value());
+            if (database_file)
+                watcher.watch(database_file.value());
+            auto update_dependencies = [&] {
+                // the files may include other files now
+                dependencies = standardese_tool::get_dependencies(previous);
+                for (auto& file : dependencies)
+                    watcher.watch(file);
+                snapshot = standardese_tool::get_snapshot(get_watched(input), snapshot);
+            };
+            update_dependencies();
+
+            while (true)
             {
-                std::cerr << "error: " << ex.what() << '\n';
+                std::clog << "waiting for changes...\n";
+                watcher.wait();
+
+                try
+                {
+                    // files may have been added or removed as well
+                    auto new_input    = get_input(options);
+                    auto new_snapshot = standardese_tool::get_snapshot(get_watched(new_input));
+                    auto changed      = standardese_tool::get_changes(snapshot, new_snapshot);
+                    if (changed.empty())
+                        continue;
+
+                    if (database_file
+                        && std::find(changed.begin(), changed.end(), database_file.value())
+                               != changed.end())
+                    {
+                        // the flags of every file may have changed
+                        database.reset();
+                        database.emplace(
+                            get_option<std::string>(options, "compilation.commands_dir").value());
+                        previous.clear();
+                    }
+
+                    input    = std::move(new_input);
+                    snapshot = std::move(new_snapshot);
+                    run(input, changed);
+                    update_dependencies();
+                }
+                catch (std::exception& ex)
+                {
+                    // keep watching, the error might be fixed with the next change
+                    std::cerr << "error: " << ex.what() << '\n';
+                }
             }
         }
     }
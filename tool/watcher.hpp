@@ -0,0 +1,214 @@
+// Copyright (C) 2016-2019 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef STANDARDESE_WATCHER_HPP_INCLUDED
+#define STANDARDESE_WATCHER_HPP_INCLUDED
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#    include <poll.h>
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+#include "filesystem.hpp"
+
+namespace standardese_tool
+{
+// the contents of some files, hashed
+//
+// Unlike the modification time, it doesn't change if a file is only touched
+// and it is precise enough for quick successive edits.
+using file_snapshot = std::map<fs::path, std::size_t>;
+
+inline std::size_t hash_file(const fs::path& path)
+{
+    // the file might have been removed in the meantime, which hashes like an empty file
+    std::ifstream in(path.string(), std::ios::binary);
+    std::string   content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    return std::hash<std::string>{}(content);
+}
+
+// if the old snapshot has a file already, its hash is reused
+inline file_snapshot get_snapshot(const std::vector<fs::path>& files,
+                                  const file_snapshot&         old = {})
+{
+    file_snapshot result;
+    for (auto& file : files)
+    {
+        auto iter = old.find(file);
+        result.emplace(file, iter != old.end() ? iter->second : hash_file(file));
+    }
+    return result;
+}
+
+// the files that have been changed, added or removed
+inline std::vector<fs::path> get_changes(const file_snapshot& old, const file_snapshot& cur)
+{
+    std::vector<fs::path> result;
+    for (auto& file : cur)
+    {
+        auto iter = old.find(file.first);
+        if (iter == old.end() || iter->second != file.second)
+            result.push_back(file.first);
+    }
+    for (auto& file : old)
+        if (cur.find(file.first) == cur.end())
+            result.push_back(file.first);
+    return result;
+}
+
+// waits for changes in some files and directories
+//
+// On Linux, inotify wakes it up if something in the watched directories changes,
+// otherwise or if inotify can't be used, it polls.
+// It does not report what has changed, compare snapshots for that.
+class file_watcher
+{
+public:
+    // watches the given files and directories, including all subdirectories
+    explicit file_watcher(std::vector<fs::path> paths) : paths_(std::move(paths))
+    {
+#if defined(__linux__)
+        fd_ = inotify_init1(IN_CLOEXEC);
+        if (fd_ < 0)
+            std::clog << "warning: unable to use inotify (" << std::strerror(errno)
+                      << "), checking for changes every second\n";
+        else
+            add_watches();
+#endif
+    }
+
+    file_watcher(const file_watcher&) = delete;
+    file_watcher& operator=(const file_watcher&) = delete;
+
+    ~file_watcher() noexcept
+    {
+#if defined(__linux__)
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    // watches another file or directory as well
+    void watch(fs::path path)
+    {
+        if (std::find(paths_.begin(), paths_.end(), path) != paths_.end())
+            return;
+
+        paths_.push_back(std::move(path));
+#if defined(__linux__)
+        add_watches(paths_.back());
+#endif
+    }
+
+    // blocks until something might have changed
+    void wait()
+    {
+#if defined(__linux__)
+        if (fd_ < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            return;
+        }
+
+        // editors tend to write a file in multiple steps,
+        // so wait until there haven't been any events for a while
+        pollfd fd{fd_, POLLIN, 0};
+        auto   timeout = -1;
+        while (auto result = poll(&fd, 1, timeout))
+        {
+            if (result < 0)
+            {
+                if (errno != EINTR)
+                    throw std::system_error(errno, std::generic_category(),
+                                            "unable to wait for changes");
+                continue;
+            }
+
+            // the events themselves are not needed
+            char buffer[4096];
+            if (read(fd_, buffer, sizeof(buffer)) < 0 && errno != EINTR)
+                throw std::system_error(errno, std::generic_category(),
+                                        "unable to read inotify events");
+            timeout = 100;
+        }
+
+        // watch directories that have been created as well
+        add_watches();
+#else
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    void add_watch(const fs::path& dir)
+    {
+        if (fd_ < 0)
+            return;
+
+        // watching a directory that is already watched does nothing,
+        // and one that has been removed in the meantime doesn't need to be watched
+        auto wd = inotify_add_watch(fd_, dir.c_str(),
+                                    IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVE | IN_ATTRIB);
+        if (wd < 0 && errno != ENOENT)
+        {
+            // a directory that isn't watched would never wake up wait(), e.g. if the limit of
+            // watches is reached, so don't rely on inotify at all
+            std::clog << "warning: unable to watch '" << dir.string() << "' ("
+                      << std::strerror(errno) << "), checking for changes every second\n";
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    void add_watches(const fs::path& path)
+    {
+        if (fs::is_directory(path))
+        {
+            add_watch(path);
+
+            boost::system::error_code ec;
+            auto end = fs::recursive_directory_iterator();
+            for (auto iter = fs::recursive_directory_iterator(path, ec);
+                 !ec && fd_ >= 0 && iter != end; iter.increment(ec))
+                if (fs::is_directory(iter->path()))
+                    add_watch(iter->path());
+        }
+        else
+            // files are often replaced by renaming, which is only visible in the directory
+            add_watch(fs::absolute(path).parent_path());
+    }
+
+    void add_watches()
+    {
+        for (auto& path : paths_)
+            if (fd_ < 0)
+                break;
+            else
+                add_watches(path);
+    }
+
+    int fd_;
+#endif
+
+    std::vector<fs::path> paths_;
+};
+} // namespace standardese_tool
+
+#endif // STANDARDESE_WATCHER_HPP_INCLUDED